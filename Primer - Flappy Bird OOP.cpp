@@ -11,8 +11,598 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <memory>
+#include <deque>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <random>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLAPPY_SSE2
+#endif
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include <SFML/Audio.hpp>
 
+// ALLOCATION COUNTER
+
+// The global operator new is replaced so benchmarks can count heap allocations per tick
+static std::atomic<std::uint64_t> heapAllocationCount(0);
+
+// Get the number of heap allocations made so far, on any thread
+std::uint64_t getHeapAllocationCount() {
+    return heapAllocationCount.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+// TRACE RECORDER
+
+// One begin or end marker of a traced scope
+// The fields are relaxed atomics guarded by the sequence like a seqlock, so a slot can be read while another thread
+// overwrites it; the reader drops the copy if the sequence moved
+struct TraceEvent {
+    std::atomic<std::uint64_t> sequence; // number of the event plus one, set once the event is complete, 0 while writing
+    std::atomic<const char*> name; // a string literal, so recording never copies it
+    std::atomic<std::int64_t> timestamp; // nanoseconds since the recorder started
+    std::atomic<std::uint32_t> threadId;
+    std::atomic<char> phase; // 'B' begins a scope, 'E' ends it
+};
+
+// Keeps the last events of the traced scopes, so rare hitches can be explained after the fact
+// Recording claims a slot with one atomic increment and overwrites the oldest event, so it never locks
+// or allocates and stays on in release builds. writeJson saves the events in the chrome://tracing format.
+class TraceRecorder {
+private:
+    static const size_t capacity = 1 << 16; // events, a power of two so an event's slot is a mask
+    TraceEvent events[capacity];
+    std::atomic<std::uint64_t> eventCount;
+    std::chrono::steady_clock::time_point start;
+    static std::uint32_t getThreadId();
+
+public:
+    TraceRecorder();
+    void record(const char* name, char phase);
+    bool writeJson(const std::string& path) const;
+};
+
+TraceRecorder::TraceRecorder()
+    : eventCount(0), start(std::chrono::steady_clock::now()) {
+    for (TraceEvent& event : events) {
+        event.sequence.store(0, std::memory_order_relaxed);
+    }
+}
+
+// Small number for the calling thread, handed out on its first event
+std::uint32_t TraceRecorder::getThreadId() {
+    static std::atomic<std::uint32_t> threadCount(0);
+    thread_local std::uint32_t threadId = threadCount.fetch_add(1, std::memory_order_relaxed) + 1;
+    return threadId;
+}
+
+// Record a begin or end marker
+void TraceRecorder::record(const char* name, char phase) {
+    std::uint64_t number = eventCount.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent& event = events[number & (capacity - 1)];
+    event.sequence.store(0, std::memory_order_relaxed); // a writer still filling the slot leaves it incomplete
+    std::atomic_thread_fence(std::memory_order_release); // a reader that sees the new fields also sees the cleared sequence
+    event.name.store(name, std::memory_order_relaxed);
+    event.timestamp.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+    event.threadId.store(getThreadId(), std::memory_order_relaxed);
+    event.phase.store(phase, std::memory_order_relaxed);
+    event.sequence.store(number + 1, std::memory_order_release);
+}
+
+// Write the recorded events as a chrome://tracing JSON file, which Perfetto opens too
+// Events still being written, or overwritten while saving, are left out
+bool TraceRecorder::writeJson(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error writing trace " << path << std::endl;
+        return false;
+    }
+    std::uint64_t end = eventCount.load(std::memory_order_acquire);
+    std::uint64_t begin = end > capacity ? end - capacity : 0;
+    file << "{\"traceEvents\":[";
+    bool first = true;
+    for (std::uint64_t number = begin; number < end; number++) {
+        const TraceEvent& event = events[number & (capacity - 1)];
+        if (event.sequence.load(std::memory_order_acquire) != number + 1) {
+            continue;
+        }
+        const char* name = event.name.load(std::memory_order_relaxed);
+        std::int64_t timestamp = event.timestamp.load(std::memory_order_relaxed);
+        std::uint32_t threadId = event.threadId.load(std::memory_order_relaxed);
+        char phase = event.phase.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire); // the copy is read before the sequence is checked again
+        if (event.sequence.load(std::memory_order_relaxed) != number + 1) {
+            continue; // overwritten while it was copied
+        }
+        file << (first ? "\n" : ",\n") << "{\"name\":\"" << name << "\",\"ph\":\"" << phase
+            << "\",\"ts\":" << timestamp / 1000 << "." << std::setw(3) << std::setfill('0') << timestamp % 1000 << std::setfill(' ')
+            << ",\"pid\":1,\"tid\":" << threadId << "}";
+        first = false;
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return static_cast<bool>(file);
+}
+
+// The recorder every traced scope writes to
+TraceRecorder& getTraceRecorder() {
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+// TraceScope class
+// Records a begin marker when it is created and an end marker when its scope ends
+class TraceScope {
+private:
+    const char* name;
+
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+TraceScope::TraceScope(const char* name)
+    : name(name) {
+    getTraceRecorder().record(name, 'B');
+}
+
+TraceScope::~TraceScope() {
+    getTraceRecorder().record(name, 'E');
+}
+
+// Trace the rest of the enclosing scope; the name must be a string literal
+#define TRACE_SCOPE(name) TraceScope traceScope(name)
+
+// ASSET REGISTRY
+
+// Texture that is only uploaded to the GPU when the game renders.
+// Headless runs have no OpenGL context, so they keep just the image size for sprite bounds.
+// A texture can also be a region of an atlas texture it shares with other assets.
+class TextureAsset {
+private:
+    std::shared_ptr<sf::Texture> texture;
+    sf::IntRect region;
+    sf::Vector2u size;
+
+public:
+    bool loadFromFile(const std::string& path, bool headless);
+    void setRegion(const std::shared_ptr<sf::Texture>& atlas, const sf::IntRect& region);
+    void applyTo(sf::Sprite& sprite) const;
+    sf::Vector2u getSize() const;
+};
+
+// Load the texture, or only read the image size when running headless
+bool TextureAsset::loadFromFile(const std::string& path, bool headless) {
+    if (headless) {
+        sf::Image image; // sf::Image is decoded on the CPU and needs no OpenGL context
+        if (!image.loadFromFile(path)) {
+            return false;
+        }
+        size = image.getSize();
+        return true;
+    }
+    texture.reset(new sf::Texture());
+    if (!texture->loadFromFile(path)) {
+        return false;
+    }
+    size = texture->getSize();
+    region = sf::IntRect(0, 0, static_cast<int>(size.x), static_cast<int>(size.y));
+    return true;
+}
+
+// Use a region of an atlas texture
+void TextureAsset::setRegion(const std::shared_ptr<sf::Texture>& atlas, const sf::IntRect& region) {
+    texture = atlas;
+    this->region = region;
+    size = sf::Vector2u(static_cast<unsigned int>(region.width), static_cast<unsigned int>(region.height));
+}
+
+// Bind the texture to the sprite, or give it a texture rect of the right size when headless
+void TextureAsset::applyTo(sf::Sprite& sprite) const {
+    if (texture) {
+        sprite.setTexture(*texture);
+        sprite.setTextureRect(region);
+    }
+    else {
+        sprite.setTextureRect(sf::IntRect(0, 0, static_cast<int>(size.x), static_cast<int>(size.y)));
+    }
+}
+
+// Get the size of the texture
+sf::Vector2u TextureAsset::getSize() const {
+    return size;
+}
+
+typedef std::shared_ptr<const TextureAsset> TextureHandle;
+typedef std::shared_ptr<const sf::Font> FontHandle;
+typedef std::shared_ptr<const sf::SoundBuffer> SoundBufferHandle;
+
+// AssetRegistry class
+// Loads each texture, font and sound buffer once per path and hands out shared handles to it.
+// The registry only keeps weak references, so an asset is freed when its last handle goes away
+// and loaded again the next time it is asked for. Everything is loaded when the game is set up,
+// so the game loop never touches the disk.
+class AssetRegistry {
+private:
+    bool headless;
+    std::map<std::string, std::weak_ptr<const TextureAsset>> textures;
+    std::map<std::string, std::weak_ptr<const sf::Font>> fonts;
+    std::map<std::string, std::weak_ptr<const sf::SoundBuffer>> soundBuffers;
+    std::vector<TextureHandle> atlasRegions; // kept alive as long as the registry
+    size_t loadCount;
+    template <typename Asset, typename Load>
+    std::shared_ptr<const Asset> get(std::map<std::string, std::weak_ptr<const Asset>>& cache, const std::string& path, Load load);
+
+public:
+    AssetRegistry(bool headless, const std::vector<std::string>& atlasPaths = std::vector<std::string>());
+    void packAtlas(const std::vector<std::string>& paths);
+    TextureHandle getTexture(const std::string& path);
+    FontHandle getFont(const std::string& path);
+    SoundBufferHandle getSoundBuffer(const std::string& path);
+    size_t getLoadCount() const;
+};
+
+AssetRegistry::AssetRegistry(bool headless, const std::vector<std::string>& atlasPaths)
+    : headless(headless), loadCount(0) {
+    if (!atlasPaths.empty()) {
+        packAtlas(atlasPaths);
+    }
+}
+
+// Return the cached asset, or load it if no handle to it is alive
+// A file that fails to load still gets an empty asset, so the game runs on without it
+template <typename Asset, typename Load>
+std::shared_ptr<const Asset> AssetRegistry::get(std::map<std::string, std::weak_ptr<const Asset>>& cache, const std::string& path, Load load) {
+    std::weak_ptr<const Asset>& cached = cache[path];
+    std::shared_ptr<const Asset> asset = cached.lock();
+    if (!asset) {
+        TRACE_SCOPE("asset load");
+        std::shared_ptr<Asset> loaded = std::make_shared<Asset>();
+        if (!load(*loaded)) {
+            std::cerr << "Error loading " << path << std::endl;
+        }
+        loadCount++;
+        asset = loaded;
+        cached = asset;
+    }
+    return asset;
+}
+
+// Pack images into one atlas texture, so sprites using any of them can be drawn in one batch
+// Later getTexture calls for these paths return their region of the atlas. Images are placed on shelves,
+// tallest first, in a page as wide as the widest image; if the page does not fit in a texture, or the game
+// is headless, the images are loaded as separate textures instead.
+void AssetRegistry::packAtlas(const std::vector<std::string>& paths) {
+    std::vector<sf::Image> images(paths.size());
+    std::vector<size_t> order(paths.size());
+    unsigned int pageWidth = 0;
+    bool loaded = !headless;
+    {
+        TRACE_SCOPE("asset load"); // the packed images are read here rather than through get
+        for (size_t i = 0; i < paths.size() && loaded; i++) {
+            loaded = images[i].loadFromFile(paths[i]);
+            pageWidth = std::max(pageWidth, images[i].getSize().x);
+            order[i] = i;
+        }
+    }
+
+    std::vector<sf::IntRect> regions(paths.size());
+    unsigned int x = 0;
+    unsigned int shelfTop = 0;
+    unsigned int shelfHeight = 0;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return images[a].getSize().y > images[b].getSize().y; });
+    for (size_t i : order) {
+        sf::Vector2u imageSize = images[i].getSize();
+        if (x + imageSize.x > pageWidth) {
+            x = 0;
+            shelfTop += shelfHeight;
+            shelfHeight = 0;
+        }
+        regions[i] = sf::IntRect(static_cast<int>(x), static_cast<int>(shelfTop), static_cast<int>(imageSize.x), static_cast<int>(imageSize.y));
+        x += imageSize.x;
+        shelfHeight = std::max(shelfHeight, imageSize.y);
+    }
+    unsigned int pageHeight = shelfTop + shelfHeight;
+
+    std::shared_ptr<sf::Texture> atlas;
+    if (loaded && pageWidth <= sf::Texture::getMaximumSize() && pageHeight <= sf::Texture::getMaximumSize()) {
+        TRACE_SCOPE("asset load");
+        sf::Image page;
+        page.create(pageWidth, pageHeight, sf::Color::Transparent);
+        for (size_t i = 0; i < images.size(); i++) {
+            page.copy(images[i], static_cast<unsigned int>(regions[i].left), static_cast<unsigned int>(regions[i].top));
+        }
+        atlas = std::make_shared<sf::Texture>();
+        if (!atlas->loadFromImage(page)) {
+            atlas.reset();
+        }
+    }
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!atlas) {
+            atlasRegions.push_back(getTexture(paths[i]));
+            continue;
+        }
+        std::shared_ptr<TextureAsset> region = std::make_shared<TextureAsset>();
+        region->setRegion(atlas, regions[i]);
+        textures[paths[i]] = region;
+        atlasRegions.push_back(region);
+        loadCount++;
+    }
+}
+
+// Get a texture, which is only uploaded to the GPU when the game renders
+TextureHandle AssetRegistry::getTexture(const std::string& path) {
+    return get(textures, path, [&](TextureAsset& texture) { return texture.loadFromFile(path, headless); });
+}
+
+// Get a font
+FontHandle AssetRegistry::getFont(const std::string& path) {
+    return get(fonts, path, [&](sf::Font& font) { return font.loadFromFile(path); });
+}
+
+// Get a sound buffer; this opens the audio device, so headless games never ask for one
+SoundBufferHandle AssetRegistry::getSoundBuffer(const std::string& path) {
+    return get(soundBuffers, path, [&](sf::SoundBuffer& buffer) { return buffer.loadFromFile(path); });
+}
+
+// Get the number of files read from disk so far
+size_t AssetRegistry::getLoadCount() const {
+    return loadCount;
+}
+
+
+
+// SPRITE BATCH CLASS
+
+// Collects sprites into one vertex array and draws them in a single call
+// Sprites from the same atlas share a batch; a sprite with another texture first draws what was collected.
+// The vertex array keeps its memory between frames.
+class SpriteBatch {
+private:
+    sf::VertexArray vertices;
+    const sf::Texture* texture;
+    sf::RenderTarget* target;
+
+public:
+    SpriteBatch();
+    void begin(sf::RenderTarget& target);
+    void add(const sf::Sprite& sprite, const sf::Vector2f& offset = sf::Vector2f(0.0f, 0.0f));
+    void end();
+    void flush();
+};
+
+SpriteBatch::SpriteBatch()
+    : vertices(sf::Triangles), texture(nullptr), target(nullptr) {
+}
+
+// Start collecting sprites for a target
+void SpriteBatch::begin(sf::RenderTarget& target) {
+    this->target = &target;
+    texture = nullptr;
+    vertices.clear();
+}
+
+// Add a sprite as two triangles, transformed on the CPU and moved by offset
+void SpriteBatch::add(const sf::Sprite& sprite, const sf::Vector2f& offset) {
+    if (sprite.getTexture() != texture) {
+        flush();
+        texture = sprite.getTexture();
+    }
+
+    const sf::Transform& transform = sprite.getTransform();
+    sf::IntRect rect = sprite.getTextureRect();
+    float width = static_cast<float>(std::abs(rect.width));
+    float height = static_cast<float>(std::abs(rect.height));
+    float left = static_cast<float>(rect.left);
+    float top = static_cast<float>(rect.top);
+    float right = left + rect.width;
+    float bottom = top + rect.height;
+    sf::Color color = sprite.getColor();
+
+    sf::Vertex topLeft(transform.transformPoint(0.0f, 0.0f) + offset, color, sf::Vector2f(left, top));
+    sf::Vertex topRight(transform.transformPoint(width, 0.0f) + offset, color, sf::Vector2f(right, top));
+    sf::Vertex bottomRight(transform.transformPoint(width, height) + offset, color, sf::Vector2f(right, bottom));
+    sf::Vertex bottomLeft(transform.transformPoint(0.0f, height) + offset, color, sf::Vector2f(left, bottom));
+    vertices.append(topLeft);
+    vertices.append(topRight);
+    vertices.append(bottomRight);
+    vertices.append(topLeft);
+    vertices.append(bottomRight);
+    vertices.append(bottomLeft);
+}
+
+// Draw the sprites collected so far
+void SpriteBatch::flush() {
+    if (target && vertices.getVertexCount() > 0) {
+        target->draw(vertices, sf::RenderStates(texture));
+    }
+    vertices.clear();
+}
+
+// Draw the rest of the batch
+void SpriteBatch::end() {
+    flush();
+    target = nullptr;
+}
+
+// Get the rectangle of the world the target's view shows, for culling what lies outside it
+sf::FloatRect getVisibleArea(const sf::RenderTarget& target) {
+    const sf::View& view = target.getView();
+    return sf::FloatRect(view.getCenter() - view.getSize() / 2.0f, view.getSize());
+}
+
+
+
+// CACHED PANEL CLASS
+
+// Draws a screen's box and texts once into a texture covering them, then draws that texture as a single quad until
+// the screen invalidates it, so an unchanged menu lays out and draws no text.
+// The texture is made on the first draw, so headless games never create one; if it cannot be created, the screen's
+// parts are drawn directly every frame.
+class CachedPanel {
+private:
+    std::unique_ptr<sf::RenderTexture> texture;
+    sf::Sprite sprite;
+    sf::IntRect area; // window pixels the texture covers
+    bool dirty;
+    bool failed; // creating the texture failed, so the parts are drawn directly
+
+public:
+    CachedPanel();
+    void invalidate(const sf::FloatRect& bounds);
+    template <typename DrawParts>
+    void draw(sf::RenderTarget& target, DrawParts drawParts);
+    static sf::FloatRect unite(const sf::FloatRect& first, const sf::FloatRect& second);
+};
+
+CachedPanel::CachedPanel()
+    : dirty(true), failed(false) {
+}
+
+// Redraw the texture on the next draw, covering the given bounds
+// The bounds are rounded out to whole pixels, so the texture maps one to one onto the window and text stays sharp
+void CachedPanel::invalidate(const sf::FloatRect& bounds) {
+    int left = static_cast<int>(std::floor(bounds.left));
+    int top = static_cast<int>(std::floor(bounds.top));
+    int right = static_cast<int>(std::ceil(bounds.left + bounds.width));
+    int bottom = static_cast<int>(std::ceil(bounds.top + bounds.height));
+    area = sf::IntRect(left, top, std::max(right - left, 1), std::max(bottom - top, 1));
+    dirty = true;
+}
+
+// Draw the cached texture, first drawing the parts into it if the panel was invalidated
+// drawParts(target) draws the screen's parts at their window positions
+template <typename DrawParts>
+void CachedPanel::draw(sf::RenderTarget& target, DrawParts drawParts) {
+    if (dirty && !failed) {
+        sf::Vector2u size(static_cast<unsigned int>(area.width), static_cast<unsigned int>(area.height));
+        if (!texture || texture->getSize() != size) {
+            texture.reset(new sf::RenderTexture());
+            if (!texture->create(size.x, size.y)) {
+                std::cerr << "Error creating panel texture" << std::endl;
+                texture.reset();
+                failed = true;
+            }
+        }
+        if (texture) {
+            texture->setView(sf::View(sf::FloatRect(sf::Vector2f(area.left, area.top), sf::Vector2f(area.width, area.height)))); // the texture shows the panel's part of the window
+            texture->clear(sf::Color::Transparent);
+            drawParts(*texture);
+            texture->display();
+            sprite.setTexture(texture->getTexture(), true);
+            sprite.setPosition(static_cast<float>(area.left), static_cast<float>(area.top));
+        }
+        dirty = false;
+    }
+    if (texture) {
+        // The parts were blended onto a transparent texture, so its colors are already multiplied by alpha; blending
+        // them by alpha again would darken the antialiased edges of text outside the box
+        target.draw(sprite, sf::RenderStates(sf::BlendMode(sf::BlendMode::One, sf::BlendMode::OneMinusSrcAlpha)));
+    }
+    else {
+        drawParts(target);
+    }
+}
+
+// Get the smallest rectangle holding both rectangles
+sf::FloatRect CachedPanel::unite(const sf::FloatRect& first, const sf::FloatRect& second) {
+    float left = std::min(first.left, second.left);
+    float top = std::min(first.top, second.top);
+    float right = std::max(first.left + first.width, second.left + second.width);
+    float bottom = std::max(first.top + first.height, second.top + second.height);
+    return sf::FloatRect(left, top, right - left, bottom - top);
+}
+
+
+
+// RANDOM NUMBER GENERATOR CLASS
+
+// Seeded random numbers owned by one game, so a seed and an input recording replay the same game
+// std::mt19937 output is fixed by the standard, unlike std::rand and the std distributions
+class GameRandom {
+private:
+    std::mt19937 engine;
+    std::uint32_t seed;
+
+public:
+    explicit GameRandom(std::uint32_t seed);
+    int next(int bound);
+    std::uint32_t getSeed() const;
+};
+
+// Seed the generator
+GameRandom::GameRandom(std::uint32_t seed)
+    : engine(seed), seed(seed) {
+}
+
+// Get a random number between 0 and bound - 1, used like std::rand() % bound
+int GameRandom::next(int bound) {
+    if (bound <= 0) {
+        return 0;
+    }
+    return static_cast<int>(engine() % static_cast<std::uint32_t>(bound));
+}
+
+// Get the seed the generator was created with
+std::uint32_t GameRandom::getSeed() const {
+    return seed;
+}
+
 // CLOUD CLASS
 class Cloud {
 private:
@@ -25,7 +615,7 @@ private:
 public:
     Cloud(const std::string& texturePath, float cloudFloatSpeed, float respawnXPosition);
     void update(float deltaTime);
-    void draw(sf::RenderWindow& window) const;
+    void draw(sf::RenderTarget& target) const;
     bool isOffScreen() const;
 };
 
@@ -56,8 +646,8 @@ void Cloud::update(float deltaTime) {
 }
 
 // Check if the cloud has gone off the screen
-void Cloud::draw(sf::RenderWindow& window) const {
-    window.draw(sprite);
+void Cloud::draw(sf::RenderTarget& target) const {
+    target.draw(sprite);
 }
 
 // Check if the cloud has gone off the screen
@@ -71,17 +661,18 @@ bool Cloud::isOffScreen() const {
 
 class Bird {
 private:
-    sf::Texture texture;
+    TextureHandle texture;
     sf::Sprite sprite;
+    sf::Vector2f previousPosition; // position before the last update, for drawing between ticks
     sf::Vector2f velocity;
     float gravity;
     float flapStrength;
 
 public:
-    Bird(const std::string& texturePath, const sf::Vector2f& position);
+    Bird(AssetRegistry& assets, const std::string& texturePath, const sf::Vector2f& position);
     void flap();
-    void update(bool gravityEnabled = true);
-    void draw(sf::RenderWindow& window) const;
+    void update(float deltaTime, bool gravityEnabled = true);
+    void draw(SpriteBatch& batch, float alpha = 1.0f) const;
     sf::FloatRect getBrounds() const;
     void setPosition(const sf::Vector2f& position);
     sf::Vector2f getVelocity() const;
@@ -90,15 +681,13 @@ public:
 };
 
 // Bird class functions
-// Constructor setting bird texture and position, gravity and flap strength
-Bird::Bird(const std::string& texturePath, const sf::Vector2f& position)
-    : gravity(0.0003f), flapStrength(-0.3f) {
-    if (!texture.loadFromFile(texturePath)) {
-        std::cerr << "Error loading bird texture" << std::endl;
-    }
-    sprite.setTexture(texture);
+// Constructor setting bird texture and position, gravity (pixels per second squared) and flap strength (pixels per second)
+Bird::Bird(AssetRegistry& assets, const std::string& texturePath, const sf::Vector2f& position)
+    : texture(assets.getTexture(texturePath)), gravity(3888.0f), flapStrength(-1080.0f) {
+    texture->applyTo(sprite);
     sprite.setPosition(position);
     sprite.setScale(1.0f, 1.0f);
+    previousPosition = position;
 
 }
 
@@ -112,17 +701,24 @@ void Bird::flap() {
     velocity.y = flapStrength;
 }
 
-// Update bird position by applying gravity
-void Bird::update(bool gravityEnabled) {
+// Update bird position by applying gravity over deltaTime seconds
+// The jump was tuned as one semi-implicit Euler step per 60 Hz frame, which lags the exact arc by half a
+// 60 Hz step of gravity. Moving along the exact arc plus that lag gives the same flight at any tick rate,
+// and the same positions as the tuned step at 60 Hz
+void Bird::update(float deltaTime, bool gravityEnabled) {
+    const float tunedStep = 1.0f / 60.0f;
+    previousPosition = sprite.getPosition();
+    sf::Vector2f step = velocity * deltaTime;
     if (gravityEnabled) {
-        velocity.y += gravity * 60.0f; // Multiply gravity by the frame rate
+        step.y += 0.5f * gravity * (deltaTime + tunedStep) * deltaTime;
+        velocity.y += gravity * deltaTime;
     }
-    sprite.move(velocity * 60.0f);
+    sprite.move(step);
 }
 
-// Draw bird on window
-void Bird::draw(sf::RenderWindow& window) const {
-    window.draw(sprite);
+// Draw bird into the world batch, alpha of the way from its previous position to its current one
+void Bird::draw(SpriteBatch& batch, float alpha) const {
+    batch.add(sprite, (previousPosition - sprite.getPosition()) * (1.0f - alpha));
 }
 
 // Get bird bounds for collision detection
@@ -152,31 +748,30 @@ void Bird::setVelocity(const sf::Vector2f& velocity) {
 // ScrollingBackground class
 class ScrollingBackground {
 private:
-    sf::Texture texture;
+    TextureHandle texture;
     sf::Sprite sprite1;
     sf::Sprite sprite2;
     float scrollSpeed;
+    float lastStep; // distance scrolled by the last update
 
 public:
-    ScrollingBackground(const std::string& texturePath, float scrollSpeed);
+    ScrollingBackground(AssetRegistry& assets, const std::string& texturePath, float scrollSpeed);
     void update(float deltaTime);
-    void draw(sf::RenderWindow& window) const;
+    void draw(SpriteBatch& batch, float alpha = 1.0f) const;
 };
 
 // Constructor setting background texture and scroll speed
-ScrollingBackground::ScrollingBackground(const std::string& texturePath, float scrollSpeed)
-    : scrollSpeed(scrollSpeed) {
-    if (!texture.loadFromFile(texturePath)) {
-        std::cerr << "Error loading background texture" << std::endl;
-    }
-    sprite1.setTexture(texture);
-    sprite2.setTexture(texture);
-    sprite2.setPosition(static_cast<float>(texture.getSize().x), 0.0f); // setting second background sprite position to the right of the first sprite
+ScrollingBackground::ScrollingBackground(AssetRegistry& assets, const std::string& texturePath, float scrollSpeed)
+    : texture(assets.getTexture(texturePath)), scrollSpeed(scrollSpeed), lastStep(0.0f) {
+    texture->applyTo(sprite1);
+    texture->applyTo(sprite2);
+    sprite2.setPosition(static_cast<float>(texture->getSize().x), 0.0f); // setting second background sprite position to the right of the first sprite
 }
 
 // Update background position by scrolling it to the left
 void ScrollingBackground::update(float deltaTime) {
     float scrollOffset = scrollSpeed * deltaTime;
+    lastStep = scrollOffset;
     sprite1.move(-scrollOffset, 0.0f);
     sprite2.move(-scrollOffset, 0.0f);
 
@@ -189,43 +784,44 @@ void ScrollingBackground::update(float deltaTime) {
     }
 }
 
-// Draw background on window
-void ScrollingBackground::draw(sf::RenderWindow& window) const {
-    window.draw(sprite1);
-    window.draw(sprite2);
+// Draw background into the world batch, alpha of the way through the last scroll step
+// Interpolating the step rather than the positions keeps a sprite that just wrapped from sweeping across the screen
+void ScrollingBackground::draw(SpriteBatch& batch, float alpha) const {
+    sf::Vector2f lag((1.0f - alpha) * lastStep, 0.0f);
+    batch.add(sprite1, lag);
+    batch.add(sprite2, lag);
 }
 
 // Ground class
 class ScrollingGround {
 private:
-    sf::Texture texture;
+    TextureHandle texture;
     sf::Sprite sprite1;
     sf::Sprite sprite2;
     float scrollSpeed;
+    float lastStep; // distance scrolled by the last update
 
 public:
-    ScrollingGround(const std::string& texturePath, float scrollSpeed, const sf::Vector2u& windowSize);
+    ScrollingGround(AssetRegistry& assets, const std::string& texturePath, float scrollSpeed, const sf::Vector2u& windowSize);
     void update(float deltaTime);
-    void draw(sf::RenderWindow& window) const;
+    void draw(SpriteBatch& batch, float alpha = 1.0f) const;
     sf::Vector2u getSize() const;
 };
 
 // Ground class functions
 // Constructor setting ground texture and scroll speed
-ScrollingGround::ScrollingGround(const std::string& texturePath, float scrollSpeed, const sf::Vector2u& windowSize)
-    : scrollSpeed(scrollSpeed) {
-    if (!texture.loadFromFile(texturePath)) {
-        std::cerr << "Error loading ground texture" << std::endl;
-    }
-    sprite1.setTexture(texture);
-    sprite2.setTexture(texture);
-    sprite1.setPosition(0.0f, static_cast<float>(windowSize.y - texture.getSize().y)); // setting first ground sprite position at the bottom of the window
-    sprite2.setPosition(static_cast<float>(texture.getSize().x), static_cast<float>(windowSize.y - texture.getSize().y)); // setting second ground sprite position to the right of the first sprite
+ScrollingGround::ScrollingGround(AssetRegistry& assets, const std::string& texturePath, float scrollSpeed, const sf::Vector2u& windowSize)
+    : texture(assets.getTexture(texturePath)), scrollSpeed(scrollSpeed), lastStep(0.0f) {
+    texture->applyTo(sprite1);
+    texture->applyTo(sprite2);
+    sprite1.setPosition(0.0f, static_cast<float>(windowSize.y - texture->getSize().y)); // setting first ground sprite position at the bottom of the window
+    sprite2.setPosition(static_cast<float>(texture->getSize().x), static_cast<float>(windowSize.y - texture->getSize().y)); // setting second ground sprite position to the right of the first sprite
 }
 
 // Update ground position by scrolling it to the left
 void ScrollingGround::update(float deltaTime) {
     float scrollOffset = scrollSpeed * deltaTime;
+    lastStep = scrollOffset;
     sprite1.move(-scrollOffset, 0.0f);
     sprite2.move(-scrollOffset, 0.0f);
 
@@ -245,172 +841,563 @@ void ScrollingGround::update(float deltaTime) {
 
 // Get the size of the ground sprite
 sf::Vector2u ScrollingGround::getSize() const {
-    return texture.getSize();
+    return texture->getSize();
 }
 
-// Draw ground on window
-void ScrollingGround::draw(sf::RenderWindow& window) const {
-    window.draw(sprite1);
-    window.draw(sprite2);
+// Draw ground into the world batch, alpha of the way through the last scroll step
+void ScrollingGround::draw(SpriteBatch& batch, float alpha) const {
+    sf::Vector2f lag((1.0f - alpha) * lastStep, 0.0f);
+    batch.add(sprite1, lag);
+    batch.add(sprite2, lag);
 }
 
 
 // SCORE BOARD FUNCTION
 
-// ScoreBoard class
-
-class ScoreBoard {
+// ScoreLog class
+// Append-only log of every submitted score, one checksummed record per line:
+//   <name> <score> <checksum>
+// where the checksum is the FNV-1a hash of "<name> <score>" in hex. A record only counts when its line is complete and
+// its checksum matches, so a record torn by a power cut is dropped instead of the whole table.
+// The log is read once when the game starts. When the log has damaged records, or is first made from the old
+// scoreboard.txt, the valid records are written to a temporary file that is synced and renamed over the log, so the
+// log on disk is always either the old or the new one.
+// Submitting a score only queues it: a worker thread, started on the first score, appends and syncs the records, so
+// slow storage never holds up a frame. The queue is a fixed ring handed over with atomics, the game thread never
+// locks. Destroying the log waits for every queued score to be written.
+class ScoreLog {
 private:
-    sf::RectangleShape backgroundBox;
-    sf::Text text;
-    std::vector<std::pair<std::string, int>> scores;
-    const std::string filename = "scoreboard.txt";
-    sf::Text titleText;
+    struct QueuedScore {
+        std::string name;
+        int score;
+    };
+    static const size_t queueCapacity = 16; // scores waiting for the worker
+    std::string path;
+    std::string legacyPath;
+    std::FILE* file; // opened by the worker for appending on the first submitted score
+    bool appendFailed; // a failed append may have left a torn line, so nothing more is appended
+    QueuedScore queue[queueCapacity];
+    std::atomic<size_t> queueHead; // next score the worker writes
+    std::atomic<size_t> queueTail; // next free slot, only moved by the game thread
+    std::atomic<bool> stopping;
+    std::atomic<std::uint64_t> failedCount;
+    std::thread worker;
+    std::mutex wakeMutex; // only held by the worker while it sleeps
+    std::condition_variable wake;
+
+    static std::uint32_t checksum(const std::string& text);
+    static std::string formatRecord(const std::string& name, int score);
+    static bool parseRecord(const std::string& line, std::pair<std::string, int>& record);
+    static bool syncFile(std::FILE* file);
+    static bool isMissing(const std::string& path);
+    static bool replaceFile(const std::string& from, const std::string& to);
+    bool compact(const std::vector<std::pair<std::string, int>>& records);
+    bool writeRecord(const std::string& name, int score);
+    void runWorker();
 
 public:
-    sf::Font font;
-    ScoreBoard(const sf::Vector2u& windowSize);
-    void addScore(const std::string& name, int score);
-    void saveScores();
-    void loadScores();
-    void draw(sf::RenderWindow& window);
-    bool isVisible;
-    void setScoreBoard(const sf::Vector2u& windowSize);
-
+    ScoreLog(const std::string& path, const std::string& legacyPath);
+    ~ScoreLog();
+    ScoreLog(const ScoreLog&) = delete;
+    ScoreLog& operator=(const ScoreLog&) = delete;
+    void load(std::vector<std::pair<std::string, int>>& records);
+    void append(const std::string& name, int score);
+    std::uint64_t getFailedCount() const;
 };
 
-ScoreBoard::ScoreBoard(const sf::Vector2u& windowSize)
-    : isVisible(false) {
+ScoreLog::ScoreLog(const std::string& path, const std::string& legacyPath)
+    : path(path), legacyPath(legacyPath), file(nullptr), appendFailed(false), queueHead(0), queueTail(0), stopping(false), failedCount(0) {
+}
 
-    // Load the font
-    if (!font.loadFromFile("assets/arial.ttf")) {
-        std::cout << "Error loading font" << std::endl;
+// Write every queued score before closing the log
+ScoreLog::~ScoreLog() {
+    if (worker.joinable()) {
+        stopping.store(true, std::memory_order_release);
+        wake.notify_one();
+        worker.join();
+    }
+    if (file) {
+        std::fclose(file);
     }
-
-    // Set the background box
-    backgroundBox.setSize(sf::Vector2f(800.0f, 400.0f));
-    backgroundBox.setFillColor(sf::Color::Black);
-    backgroundBox.setPosition(
-        (windowSize.x - backgroundBox.getSize().x) / 2.0f,
-        (windowSize.y - backgroundBox.getSize().y) / 2.0f
-    ); // center the box
-
-    // Set the text
-    text.setFont(font);
-    text.setCharacterSize(24);
-    text.setFillColor(sf::Color::White);
-
-    loadScores();
-
-
-    setScoreBoard(windowSize);
 }
 
-void ScoreBoard::setScoreBoard(const sf::Vector2u& windowSize) {
-    std::stringstream ss;
-
-
-    float leftMargin = 180.0f;
-    float tabSize = 2.0f;
-    float characterSize = 24.0f;
-    float tabWidth = tabSize * characterSize;
-
-
-    titleText.setFont(font);
-    titleText.setCharacterSize(24);
-    titleText.setFillColor(sf::Color::White);
-    titleText.setString("Scoreboard");
-    titleText.setPosition(
-        (windowSize.x - titleText.getGlobalBounds().width) / 2.0f,
-        backgroundBox.getPosition().y + 20.0f
-    );
-
-
-    for (const auto& score : scores) {
-        ss << std::left << std::setw(static_cast<int>(tabWidth)) << score.first << score.second << std::endl;
+// FNV-1a hash of a record's text
+std::uint32_t ScoreLog::checksum(const std::string& text) {
+    std::uint32_t hash = 2166136261u;
+    for (unsigned char character : text) {
+        hash = (hash ^ character) * 16777619u;
     }
+    return hash;
+}
 
-    text.setString(ss.str());
-    text.setPosition(
-        backgroundBox.getPosition().x + leftMargin,
-        titleText.getPosition().y + titleText.getGlobalBounds().height + 40.0f
-    );
-
+// Format one line of the log
+std::string ScoreLog::formatRecord(const std::string& name, int score) {
+    std::string text = name + " " + std::to_string(score);
+    char hash[16];
+    std::snprintf(hash, sizeof(hash), " %08x\n", static_cast<unsigned int>(checksum(text)));
+    return text + hash;
 }
 
-void ScoreBoard::loadScores() {
-    std::ifstream file(filename);
-    if (file.is_open()) {
-        scores.clear();
-        std::string name;
-        int score;
-        while (file >> name >> score) {
-            scores.push_back(std::make_pair(name, score));
-        }
-        file.close();
+// Read one line of the log, returns false when it is damaged
+bool ScoreLog::parseRecord(const std::string& line, std::pair<std::string, int>& record) {
+    size_t hashStart = line.rfind(' ');
+    if (hashStart == std::string::npos || line.size() - hashStart != 9) {
+        return false;
+    }
+    std::string text = line.substr(0, hashStart);
+    char* end = nullptr;
+    unsigned long hash = std::strtoul(line.c_str() + hashStart + 1, &end, 16);
+    if (*end != '\0' || hash != checksum(text)) {
+        return false;
     }
+    std::istringstream fields(text);
+    return static_cast<bool>(fields >> record.first >> record.second);
 }
 
-void ScoreBoard::addScore(const std::string& name, int score) {
-    std::cout << name << " " << score << std::endl;
-    scores.push_back(std::make_pair(name, score));
-    // Sort the scores in descending order
-    std::sort(scores.begin(), scores.end(), [](const auto& a, const auto& b) { // sort the scores in descending order
-        return a.second > b.second; // a.second is the score in the pair
-        }); // sort the scores in descending order
-    if (scores.size() > 10) {
-        scores.resize(10); // keep only the top 10 scores
+// Push a file's writes through the OS to the disk
+bool ScoreLog::syncFile(std::FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
     }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
 }
 
-void ScoreBoard::saveScores() {
-    std::ofstream file(filename);
-    if (file.is_open()) {
-        for (const auto& score : scores) {
-            file << score.first << " " << score.second << std::endl;
-        }
-        file.close();
+// Check if a file does not exist, as opposed to existing but not being readable
+bool ScoreLog::isMissing(const std::string& path) {
+#ifdef _WIN32
+    if (GetFileAttributesA(path.c_str()) != INVALID_FILE_ATTRIBUTES) {
+        return false;
     }
+    DWORD error = GetLastError();
+    return error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND;
+#else
+    struct stat status;
+    return stat(path.c_str(), &status) != 0 && errno == ENOENT;
+#endif
 }
 
-void ScoreBoard::draw(sf::RenderWindow& window) {
-    if (isVisible) {
-        window.draw(backgroundBox);
-        window.draw(text);
-        window.draw(titleText);
+// Rename a file over another in one step, so a power cut leaves one of the two
+bool ScoreLog::replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (std::rename(from.c_str(), to.c_str()) != 0) {
+        return false;
+    }
+    // Sync the directory too, so the rename itself survives a power cut
+    size_t slash = to.rfind('/');
+    std::string directoryPath = slash == std::string::npos ? "." : to.substr(0, slash + 1);
+    int directory = open(directoryPath.c_str(), O_RDONLY);
+    if (directory >= 0) {
+        fsync(directory);
+        close(directory);
+    }
+    return true;
+#endif
+}
 
+// Write the valid records to a temporary file and rename it over the log
+bool ScoreLog::compact(const std::vector<std::pair<std::string, int>>& records) {
+    std::string temporaryPath = path + ".tmp";
+    std::FILE* output = std::fopen(temporaryPath.c_str(), "wb");
+    if (!output) {
+        std::cerr << "Error writing score log " << temporaryPath << std::endl;
+        return false;
+    }
+    bool written = true;
+    for (const auto& record : records) {
+        std::string line = formatRecord(record.first, record.second);
+        written = written && std::fwrite(line.data(), 1, line.size(), output) == line.size();
     }
+    written = written && syncFile(output);
+    std::fclose(output);
+    if (!written || !replaceFile(temporaryPath, path)) {
+        std::cerr << "Error writing score log " << path << std::endl;
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
 }
 
-// Save ScoreBoard function
-class SaveScoreScreen {
-private:
-    sf::RectangleShape backgroundBox;
-    sf::Text text;
+// Read every valid record of the log, oldest first
+// Without a log the old scoreboard.txt is read and written as the first log
+// A log that exists but cannot be opened is left alone, so it is never replaced by the old scores
+void ScoreLog::load(std::vector<std::pair<std::string, int>>& records) {
+    TRACE_SCOPE("score load");
+    records.clear();
+    std::ifstream input(path, std::ios::binary);
+    if (!input.is_open()) {
+        if (!isMissing(path)) {
+            std::cerr << "Error reading score log " << path << std::endl;
+            return;
+        }
+        std::ifstream legacy(legacyPath);
+        std::pair<std::string, int> record;
+        while (legacy >> record.first >> record.second) {
+            records.push_back(record);
+        }
+        if (!records.empty()) {
+            compact(records);
+        }
+        return;
+    }
+
+    size_t damaged = 0;
+    std::string line;
+    while (std::getline(input, line)) {
+        std::pair<std::string, int> record;
+        if (!input.eof() && parseRecord(line, record)) { // a last line without its newline was torn while appending
+            records.push_back(record);
+        }
+        else {
+            damaged++;
+        }
+    }
+    input.close();
+    if (damaged > 0) {
+        std::cerr << "Dropped " << damaged << " damaged records from " << path << std::endl;
+        compact(records); // a later append must not continue a torn line
+    }
+}
+
+// Append one record and sync it to the disk, on the worker thread
+bool ScoreLog::writeRecord(const std::string& name, int score) {
+    TRACE_SCOPE("score save");
+    if (appendFailed) {
+        return false;
+    }
+    if (!file) {
+        file = std::fopen(path.c_str(), "ab");
+        if (!file) {
+            std::cerr << "Error opening score log " << path << std::endl;
+            return false;
+        }
+    }
+    std::string line = formatRecord(name, score);
+    if (std::fwrite(line.data(), 1, line.size(), file) != line.size() || !syncFile(file)) {
+        std::cerr << "Error writing score log " << path << std::endl;
+        std::fclose(file); // the next start drops the torn record and compacts the log
+        file = nullptr;
+        appendFailed = true;
+        return false;
+    }
+    return true;
+}
+
+// Write queued scores until the log is destroyed and the queue is empty
+void ScoreLog::runWorker() {
+    while (true) {
+        bool stop = stopping.load(std::memory_order_acquire); // read before the tail, so a score queued before stopping is seen
+        size_t head = queueHead.load(std::memory_order_relaxed);
+        if (head == queueTail.load(std::memory_order_acquire)) {
+            if (stop) {
+                return;
+            }
+            // The game thread notifies without the mutex, so a wakeup can be missed; the timeout bounds the delay
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(100), [this, head] {
+                return stopping.load(std::memory_order_acquire) || queueTail.load(std::memory_order_acquire) != head;
+                });
+            continue;
+        }
+        const QueuedScore& queued = queue[head % queueCapacity];
+        if (!writeRecord(queued.name, queued.score)) {
+            failedCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        queueHead.store(head + 1, std::memory_order_release);
+    }
+}
+
+// Queue a score for the worker to append
+void ScoreLog::append(const std::string& name, int score) {
+    if (!worker.joinable()) {
+        worker = std::thread(&ScoreLog::runWorker, this);
+    }
+    size_t tail = queueTail.load(std::memory_order_relaxed);
+    while (tail - queueHead.load(std::memory_order_acquire) == queueCapacity) {
+        std::this_thread::yield(); // a score is submitted once per game, so the queue is never full in play
+    }
+    queue[tail % queueCapacity].name = name;
+    queue[tail % queueCapacity].score = score;
+    queueTail.store(tail + 1, std::memory_order_release);
+    wake.notify_one();
+}
+
+// Get the number of scores the worker could not write
+std::uint64_t ScoreLog::getFailedCount() const {
+    return failedCount.load(std::memory_order_relaxed);
+}
+
+
+// ScoreRanking class
+// Counts every score ever saved in a Fenwick tree with one bucket per score, so adding a score and finding how many
+// scores beat it are both O(log n) in the highest score, however many runs the history holds.
+// The tree grows by doubling as higher scores come in; scores below 0 share the 0 bucket and scores from maxBuckets - 1
+// up share the top one, so ranks among those are ties.
+class ScoreRanking {
+private:
+    static const size_t maxBuckets = 1 << 20;
+    std::vector<std::uint64_t> tree; // 1-based, tree[i] counts the scores in buckets (i - lowbit(i), i]
+    std::uint64_t scoreCount;
+    static size_t getBucket(int score);
+    void grow(size_t bucketCount);
+
+public:
+    ScoreRanking();
+    void add(int score);
+    std::uint64_t countAbove(int score) const;
+    std::uint64_t getRank(int score) const;
+    std::uint64_t getScoreCount() const;
+};
+
+ScoreRanking::ScoreRanking()
+    : tree(1025, 0), scoreCount(0) {
+}
+
+// Get the 1-based bucket of a score
+size_t ScoreRanking::getBucket(int score) {
+    return static_cast<size_t>(std::min<std::int64_t>(std::max(score, 0), maxBuckets - 1)) + 1;
+}
+
+// Double the buckets until there are at least bucketCount
+// The bucket count is a power of two, so the new top node covers every old bucket and the other new nodes cover only
+// new, empty buckets; growing copies one count
+void ScoreRanking::grow(size_t bucketCount) {
+    size_t size = tree.size() - 1;
+    while (size < bucketCount) {
+        tree.resize(size * 2 + 1, 0);
+        tree[size * 2] = tree[size];
+        size *= 2;
+    }
+}
+
+// Count a score
+void ScoreRanking::add(int score) {
+    size_t bucket = getBucket(score);
+    grow(bucket);
+    for (size_t i = bucket; i < tree.size(); i += i & (0 - i)) {
+        tree[i]++;
+    }
+    scoreCount++;
+}
+
+// Get the number of counted scores higher than a score
+std::uint64_t ScoreRanking::countAbove(int score) const {
+    std::uint64_t atOrBelow = 0;
+    for (size_t i = std::min(getBucket(score), tree.size() - 1); i > 0; i -= i & (0 - i)) {
+        atOrBelow += tree[i];
+    }
+    return scoreCount - atOrBelow;
+}
+
+// Get the place a score takes among the counted scores, 1 is the highest; ties share a place
+std::uint64_t ScoreRanking::getRank(int score) const {
+    return countAbove(score) + 1;
+}
+
+// Get the number of counted scores
+std::uint64_t ScoreRanking::getScoreCount() const {
+    return scoreCount;
+}
+
+
+// ScoreBoard class
+// Keeps the top 10 scores in memory and every score ever saved in a ranking; the log is read once at startup and each submitted score is queued for appending
+// The box, title and table are cached in a panel that is only redrawn after the scores change, so showing the
+// scoreboard draws a single quad
+// Like every screen below, it positions its text on the first draw after a change: measuring text needs the
+// font's glyph texture, which needs the OpenGL context a headless game does not have
+
+class ScoreBoard {
+private:
+    sf::RectangleShape backgroundBox;
+    sf::Text text;
+    std::vector<std::pair<std::string, int>> scores; // top 10, highest first
+    ScoreRanking ranking; // every saved score
+    ScoreLog log;
+    sf::Text titleText;
+    sf::Vector2u windowSize;
+    bool tableDirty; // scores changed since the table text was built
+    std::uint64_t shownFailedCount; // failed writes the table text reports
+    bool layoutDirty; // the panel is redrawn with the layout
+    CachedPanel panel;
+    void updateLayout();
+    void loadScores();
+    void insertScore(const std::string& name, int score);
+
+public:
+    FontHandle font;
+    ScoreBoard(const sf::Vector2u& windowSize, AssetRegistry& assets);
+    void addScore(const std::string& name, int score);
+    std::uint64_t getRank(int score) const;
+    std::uint64_t getScoreCount() const;
+    void draw(sf::RenderTarget& target);
+    bool isVisible;
+    void setScoreBoard(const sf::Vector2u& windowSize);
+
+};
+
+ScoreBoard::ScoreBoard(const sf::Vector2u& windowSize, AssetRegistry& assets)
+    : log("scoreboard.log", "scoreboard.txt"), windowSize(windowSize), tableDirty(true), shownFailedCount(0), layoutDirty(true), font(assets.getFont("assets/arial.ttf")), isVisible(false) {
+
+    // Set the background box
+    backgroundBox.setSize(sf::Vector2f(800.0f, 400.0f));
+    backgroundBox.setFillColor(sf::Color::Black);
+    backgroundBox.setPosition(
+        (windowSize.x - backgroundBox.getSize().x) / 2.0f,
+        (windowSize.y - backgroundBox.getSize().y) / 2.0f
+    ); // center the box
+
+    // Set the text
+    text.setFont(*font);
+    text.setCharacterSize(24);
+    text.setFillColor(sf::Color::White);
+
+    // Set the title
+    titleText.setFont(*font);
+    titleText.setCharacterSize(24);
+    titleText.setFillColor(sf::Color::White);
+    titleText.setString("Scoreboard");
+
+    loadScores();
+
+
+    setScoreBoard(windowSize);
+}
+
+// Build the table text, only when the scores changed since it was last built
+void ScoreBoard::setScoreBoard(const sf::Vector2u& windowSize) {
+    std::uint64_t failedCount = log.getFailedCount();
+    if (!tableDirty && windowSize == this->windowSize && failedCount == shownFailedCount) {
+        return; // the panel still shows these scores
+    }
+
+    std::stringstream ss;
+
+    float tabSize = 2.0f;
+    float characterSize = 24.0f;
+    float tabWidth = tabSize * characterSize;
+
+    this->windowSize = windowSize;
+
+    for (const auto& score : scores) {
+        ss << std::left << std::setw(static_cast<int>(tabWidth)) << score.first << score.second << std::endl;
+    }
+    if (failedCount > 0) { // reported by the log's worker thread
+        ss << std::endl << "Some scores could not be saved" << std::endl;
+    }
+
+    text.setString(ss.str());
+    tableDirty = false;
+    shownFailedCount = failedCount;
+    layoutDirty = true; // text is positioned and the panel redrawn on the next draw
+}
+
+// Position the title and table
+void ScoreBoard::updateLayout() {
+    float leftMargin = 180.0f;
+
+    titleText.setPosition(
+        (windowSize.x - titleText.getGlobalBounds().width) / 2.0f,
+        backgroundBox.getPosition().y + 20.0f
+    );
+    text.setPosition(
+        backgroundBox.getPosition().x + leftMargin,
+        titleText.getPosition().y + titleText.getGlobalBounds().height + 40.0f
+    );
+    layoutDirty = false;
+}
+
+// Build the top 10 and the ranking from every score in the log
+void ScoreBoard::loadScores() {
+    std::vector<std::pair<std::string, int>> history;
+    log.load(history);
+    scores.clear();
+    for (const auto& record : history) {
+        insertScore(record.first, record.second);
+        ranking.add(record.second);
+    }
+    tableDirty = true;
+}
+
+// Insert a score into the top 10, after any equal scores
+void ScoreBoard::insertScore(const std::string& name, int score) {
+    auto position = std::upper_bound(scores.begin(), scores.end(), score, [](int value, const auto& entry) {
+        return value > entry.second; // entry.second is the score in the pair
+        });
+    if (position - scores.begin() >= 10) {
+        return;
+    }
+    scores.insert(position, std::make_pair(name, score));
+    if (scores.size() > 10) {
+        scores.pop_back(); // keep only the top 10 scores
+    }
+}
+
+// Add the score to the table and queue it for the log
+void ScoreBoard::addScore(const std::string& name, int score) {
+    std::cout << name << " " << score << std::endl;
+    log.append(name, score);
+    insertScore(name, score);
+    ranking.add(score);
+    tableDirty = true;
+}
+
+// Get the place a score would take among the saved scores
+std::uint64_t ScoreBoard::getRank(int score) const {
+    return ranking.getRank(score);
+}
+
+// Get the number of saved scores
+std::uint64_t ScoreBoard::getScoreCount() const {
+    return ranking.getScoreCount();
+}
+
+void ScoreBoard::draw(sf::RenderTarget& target) {
+    if (isVisible) {
+        if (layoutDirty) {
+            updateLayout();
+            panel.invalidate(CachedPanel::unite(backgroundBox.getGlobalBounds(), text.getGlobalBounds()));
+        }
+        panel.draw(target, [this](sf::RenderTarget& panelTarget) {
+            panelTarget.draw(backgroundBox);
+            panelTarget.draw(text);
+            panelTarget.draw(titleText);
+            });
+    }
+}
+
+// Save ScoreBoard function
+class SaveScoreScreen {
+private:
+    sf::RectangleShape backgroundBox;
+    sf::Text text;
     sf::Text nameText;
     sf::Text scoreText;
     std::string playerName;
     sf::Vector2u windowSize;
+    bool layoutDirty; // set by setScore and handleInput, the panel is redrawn with the layout
+    CachedPanel panel;
+    void updateLayout();
 
 public:
-    sf::Font font;
-    SaveScoreScreen(const sf::Vector2u& windowSize);
-    void draw(sf::RenderWindow& window);
+    FontHandle font;
+    SaveScoreScreen(const sf::Vector2u& windowSize, AssetRegistry& assets);
+    void draw(sf::RenderTarget& target);
     void handleInput(sf::Event& event);
     bool isVisible;
     std::string getPlayerName() const;
     void resetPlayerName();
-    void setScore(int score);
+    void setScore(int score, std::uint64_t rank, std::uint64_t scoreCount);
 
 };
 
-SaveScoreScreen::SaveScoreScreen(const sf::Vector2u& windowSize)
-    : isVisible(false), playerName(""), windowSize(windowSize) {
-
-    // Load the font
-    if (!font.loadFromFile("assets/arial.ttf")) {
-        std::cout << "Error loading font" << std::endl;
-    }
+SaveScoreScreen::SaveScoreScreen(const sf::Vector2u& windowSize, AssetRegistry& assets)
+    : playerName(""), windowSize(windowSize), layoutDirty(true), font(assets.getFont("assets/arial.ttf")), isVisible(false) {
 
     // Set the background box
     backgroundBox.setSize(sf::Vector2f(800.0f, 200.0f));
@@ -422,45 +1409,62 @@ SaveScoreScreen::SaveScoreScreen(const sf::Vector2u& windowSize)
     ); // center the box
 
     // Set up the text
-    text.setFont(font);
+    text.setFont(*font);
     text.setString("3 characters + Enter: \n\n");
 
     text.setCharacterSize(24);
     text.setFillColor(sf::Color::White);
-    text.setPosition(
-        (windowSize.x - text.getGlobalBounds().width) * (1.0f / 3.0f) + 50.0f,
-        ((windowSize.y / 2.0f) - text.getGlobalBounds().height) / 2.0f - 10.0f
-
-    ); // center the text above the input
-
 
     // Set up the name text
-    nameText.setFont(font);
+    nameText.setFont(*font);
     nameText.setCharacterSize(24);
     nameText.setFillColor(sf::Color::White);
 
 }
 
-// Set the score text on the SaveScoreScreen
-void SaveScoreScreen::setScore(int score) {
-    scoreText.setFont(font);
+// Set the score text on the SaveScoreScreen, with the rank the score takes among every score saved so far
+void SaveScoreScreen::setScore(int score, std::uint64_t rank, std::uint64_t scoreCount) {
+    scoreText.setFont(*font);
     scoreText.setCharacterSize(24);
     scoreText.setFillColor(sf::Color::White);
-    scoreText.setString("Final Score: \n\n\t\t" + std::to_string(score));
+    scoreText.setString("Final Score: \n\n\t\t" + std::to_string(score) + "\nRank " + std::to_string(rank) + " of " + std::to_string(scoreCount));
+    layoutDirty = true;
+}
+
+// Position the texts relative to the prompt
+void SaveScoreScreen::updateLayout() {
+    sf::FloatRect promptBounds = text.getGlobalBounds();
+    text.setPosition(
+        (windowSize.x - promptBounds.width) * (1.0f / 3.0f) + 50.0f,
+        ((windowSize.y / 2.0f) - promptBounds.height) / 2.0f - 10.0f
+    ); // center the text above the input
     scoreText.setPosition(
-        (windowSize.x - text.getGlobalBounds().width) * (2.0f / 3.0f) + 50.0f,
-        ((windowSize.y / 2.0f) - text.getGlobalBounds().height) / 2.0f - 10.0f
+        (windowSize.x - promptBounds.width) * (2.0f / 3.0f) + 50.0f,
+        ((windowSize.y / 2.0f) - promptBounds.height) / 2.0f - 10.0f
     ); // center the text
+    nameText.setPosition(
+        (windowSize.x - promptBounds.width) * (1.0f / 3.0f) + 130.0f,
+        ((windowSize.y / 2.0f) - promptBounds.height) / 2.0f + 40.f
+    ); // center the text
+    layoutDirty = false;
 }
 
 
 // Draw SaveScoreScreen when isVisible is true
-void SaveScoreScreen::draw(sf::RenderWindow& window) {
+void SaveScoreScreen::draw(sf::RenderTarget& target) {
     if (isVisible) {
-        window.draw(backgroundBox);
-        window.draw(text);
-        window.draw(nameText);
-        window.draw(scoreText);
+        if (layoutDirty) {
+            updateLayout();
+            sf::FloatRect bounds = CachedPanel::unite(backgroundBox.getGlobalBounds(), text.getGlobalBounds());
+            bounds = CachedPanel::unite(bounds, scoreText.getGlobalBounds());
+            panel.invalidate(CachedPanel::unite(bounds, nameText.getGlobalBounds()));
+        }
+        panel.draw(target, [this](sf::RenderTarget& panelTarget) {
+            panelTarget.draw(backgroundBox);
+            panelTarget.draw(text);
+            panelTarget.draw(nameText);
+            panelTarget.draw(scoreText);
+            });
     }
 }
 
@@ -487,11 +1491,7 @@ void SaveScoreScreen::handleInput(sf::Event& event) {
             }
         }
         nameText.setString(playerName);
-        nameText.setPosition(
-            (windowSize.x - text.getGlobalBounds().width) * (1.0f / 3.0f) + 130.0f,
-            ((windowSize.y / 2.0f) - text.getGlobalBounds().height) / 2.0f + 40.f
-        ); // center the text
-
+        layoutDirty = true;
     }
 }
 
@@ -503,10 +1503,7 @@ std::string SaveScoreScreen::getPlayerName() const {
 void SaveScoreScreen::resetPlayerName() {
     playerName.clear();
     nameText.setString(playerName);
-    nameText.setPosition(
-        (windowSize.x - nameText.getGlobalBounds().width) / 2.0f,
-        ((windowSize.y / 2.0) - nameText.getGlobalBounds().height) / 2.0f
-    ); // center the text
+    layoutDirty = true;
 }
 
 // EXIT SCREEN CLASS
@@ -519,21 +1516,21 @@ private:
     sf::Text scoreText;
     sf::Text saveScoreText;
     bool saveScoreSelected;
+    sf::Vector2u windowSize;
+    bool layoutDirty; // set by setScore, the panel is redrawn with the layout
+    CachedPanel panel;
+    void updateLayout();
 
 public:
-    sf::Font font;
-    ExitScreen(const sf::Vector2u& windowSize);
-    void draw(sf::RenderWindow& window) const;
+    FontHandle font;
+    ExitScreen(const sf::Vector2u& windowSize, AssetRegistry& assets);
+    void draw(sf::RenderTarget& target);
     bool isVisible;
     void setScore(int score);
 };
 
 // ExitScreen font, background and text setup
-ExitScreen::ExitScreen(const sf::Vector2u& windowSize) : isVisible(false) {
-    // Load the font
-    if (!font.loadFromFile("assets/arial.ttf")) {
-        std::cout << "Error loading font" << std::endl;
-    }
+ExitScreen::ExitScreen(const sf::Vector2u& windowSize, AssetRegistry& assets) : windowSize(windowSize), layoutDirty(true), font(assets.getFont("assets/arial.ttf")), isVisible(false) {
 
     // Set up the background box
     backgroundBox.setSize(sf::Vector2f(400.0f, 400.0f));
@@ -543,54 +1540,66 @@ ExitScreen::ExitScreen(const sf::Vector2u& windowSize) : isVisible(false) {
         (windowSize.y - backgroundBox.getGlobalBounds().height) / 2.0f // center the box vertically
     );
 
-    text_heading.setFont(font);
+    text_heading.setFont(*font);
     text_heading.setString("Game Over!\n\n");
     text_heading.setCharacterSize(40);
     text_heading.setFillColor(sf::Color::White);
-    text_heading.setPosition(
-        (windowSize.x - text_heading.getGlobalBounds().width) / 2.0f, // center the text horizontally
-        (windowSize.y - text_heading.getGlobalBounds().height) / 2.0f - 30.0f // center the text vertically
-    );
 
-    text_body.setFont(font);
+    text_body.setFont(*font);
     text_body.setString("Press 'Enter' to Restart");
     text_body.setCharacterSize(24);
     text_body.setFillColor(sf::Color::White);
-    text_body.setPosition(
-        (windowSize.x - text_body.getGlobalBounds().width) / 2.0f, // center the text horizontally
-        (windowSize.y - text_body.getGlobalBounds().height) / 2.0f + 20.0f // center the text vertically
-    );
 
-    saveScoreText.setFont(font);
+    saveScoreText.setFont(*font);
     saveScoreText.setString("Press 'S' for Scoreboard");
     saveScoreText.setCharacterSize(24);
     saveScoreText.setFillColor(sf::Color::White);
-    saveScoreText.setPosition(
-        (windowSize.x - saveScoreText.getGlobalBounds().width) / 2.0f, // center the text horizontally
-        (windowSize.y - saveScoreText.getGlobalBounds().height) / 2.0f + 60.0f // center the text vertically
-    );
 
 }
 // Set the score text on the exit screen
 void ExitScreen::setScore(int score) {
-    scoreText.setFont(font);
+    scoreText.setFont(*font);
     scoreText.setCharacterSize(24);
     scoreText.setFillColor(sf::Color::White);
     scoreText.setString("Final Score: " + std::to_string(score));
+    layoutDirty = true;
+}
+
+// Center the texts
+void ExitScreen::updateLayout() {
+    text_heading.setPosition(
+        (windowSize.x - text_heading.getGlobalBounds().width) / 2.0f, // center the text horizontally
+        (windowSize.y - text_heading.getGlobalBounds().height) / 2.0f - 30.0f // center the text vertically
+    );
+    text_body.setPosition(
+        (windowSize.x - text_body.getGlobalBounds().width) / 2.0f, // center the text horizontally
+        (windowSize.y - text_body.getGlobalBounds().height) / 2.0f + 20.0f // center the text vertically
+    );
+    saveScoreText.setPosition(
+        (windowSize.x - saveScoreText.getGlobalBounds().width) / 2.0f, // center the text horizontally
+        (windowSize.y - saveScoreText.getGlobalBounds().height) / 2.0f + 60.0f // center the text vertically
+    );
     scoreText.setPosition(
         (backgroundBox.getGlobalBounds().width - scoreText.getGlobalBounds().width) / 2.0f + backgroundBox.getPosition().x,
         backgroundBox.getPosition().y + backgroundBox.getGlobalBounds().height + 20.0f
     );
+    layoutDirty = false;
 }
 
 // Draw the ExitScreen when isVisible is true
-void ExitScreen::draw(sf::RenderWindow& window) const {
+void ExitScreen::draw(sf::RenderTarget& target) {
     if (isVisible) {
-        window.draw(backgroundBox);
-        window.draw(text_heading);
-        window.draw(text_body);
-        window.draw(scoreText);
-        window.draw(saveScoreText);
+        if (layoutDirty) {
+            updateLayout();
+            panel.invalidate(CachedPanel::unite(backgroundBox.getGlobalBounds(), scoreText.getGlobalBounds())); // the score sits below the box
+        }
+        panel.draw(target, [this](sf::RenderTarget& panelTarget) {
+            panelTarget.draw(backgroundBox);
+            panelTarget.draw(text_heading);
+            panelTarget.draw(text_body);
+            panelTarget.draw(scoreText);
+            panelTarget.draw(saveScoreText);
+            });
     }
 }
 
@@ -602,20 +1611,19 @@ class StartScreen {
 private:
     sf::RectangleShape backgroundBox;
     sf::Text text;
+    sf::Vector2u windowSize;
+    bool layoutDirty;
+    CachedPanel panel;
 
 public:
-    sf::Font font;
-    StartScreen(const sf::Vector2u& windowSize);
-    void draw(sf::RenderWindow& window) const;
+    FontHandle font;
+    StartScreen(const sf::Vector2u& windowSize, AssetRegistry& assets);
+    void draw(sf::RenderTarget& target);
     bool isVisible;
 };
 
 // StartScreen font, background and text setup
-StartScreen::StartScreen(const sf::Vector2u& windowSize) : isVisible(true) {
-    // Load the font
-    if (!font.loadFromFile("assets/arial.ttf")) {
-        std::cout << "Error loading front" << std::endl;
-    }
+StartScreen::StartScreen(const sf::Vector2u& windowSize, AssetRegistry& assets) : windowSize(windowSize), layoutDirty(true), font(assets.getFont("assets/arial.ttf")), isVisible(true) {
 
     // Set up the background box
     backgroundBox.setSize(sf::Vector2f(400.0f, 400.0f));
@@ -626,136 +1634,921 @@ StartScreen::StartScreen(const sf::Vector2u& windowSize) : isVisible(true) {
     );
 
     // Set up the text
-    text.setFont(font);
+    text.setFont(*font);
     text.setString("Press 'Space' to Start \n\n\n by Jag Firewalker");
     text.setCharacterSize(24);
     text.setFillColor(sf::Color::White);
-    text.setPosition(
-        (windowSize.x - text.getGlobalBounds().width) / 2.0f,
-        (windowSize.y - text.getGlobalBounds().height) / 2.0f
-    );
 
 }
 
-// Draw the StartScreen when isVisible is true
-void StartScreen::draw(sf::RenderWindow& window) const {
+// Draw the StartScreen when isVisible is true, centering the text on the first draw
+void StartScreen::draw(sf::RenderTarget& target) {
     if (isVisible) {
-        window.draw(backgroundBox);
-        window.draw(text);
+        if (layoutDirty) {
+            text.setPosition(
+                (windowSize.x - text.getGlobalBounds().width) / 2.0f,
+                (windowSize.y - text.getGlobalBounds().height) / 2.0f
+            );
+            layoutDirty = false;
+            panel.invalidate(CachedPanel::unite(backgroundBox.getGlobalBounds(), text.getGlobalBounds()));
+        }
+        panel.draw(target, [this](sf::RenderTarget& panelTarget) {
+            panelTarget.draw(backgroundBox);
+            panelTarget.draw(text);
+            });
     }
 }
 
 
 
-// FLOATING WORDS CLASS FUNCTIONS
-
-// FloatingWords class
-// Class to display floating words on the screen
-class FloatingWords {
-private:
-    sf::Font font;
-    float speed;
-    float startTime;
-    std::string filePath;
-    sf::Vector2u windowSize;
-
-
-
-public:
-    FloatingWords(const std::string& filePath, const sf::Font& font, float speed, float spawnInterval, const sf::Vector2u& windowSize, float groundHeight);
-    void update(float deltaTime);
-    void draw(sf::RenderWindow& window) const;
-    bool isVisible;
-    void setStartTime(float time);
-    sf::FloatRect getBounds(size_t index) const; // Move this function inside the class 
-    std::vector<sf::Text> words;
-    std::vector<float> spawnTimes;
-    float spawnInterval;
-    float floorPosition;
-    float skyPosition;
-    void reset();
-    sf::Color originalColor;
-};
+// WORD KERNELS
 
-// Load words from file and set their position and speed
-// push_back words and spawn times to vectors
-FloatingWords::FloatingWords(const std::string& filePath, const sf::Font& font, float speed, float spawnInterval, const sf::Vector2u& windowSize, float groundHeight)
-    : font(font), speed(speed), spawnInterval(spawnInterval), isVisible(false), startTime(-1.0f), floorPosition(windowSize.y + groundHeight + 60.0f), skyPosition(1.0f), filePath(filePath), windowSize(windowSize), originalColor(sf::Color::White) {
-    reset();
+// Subtract the same amount from every value, one at a time
+void subtractScalar(float* values, size_t count, float amount) {
+    for (size_t i = 0; i < count; i++) {
+        values[i] -= amount;
+    }
 }
 
-// Get the bounds of the floating words
-sf::FloatRect FloatingWords::getBounds(size_t index) const {
-    return words[index].getGlobalBounds();
-}
-// Update floating words position by moving them to the left
-// if the start time is greater than 0, move the words to the left
-void FloatingWords::update(float deltaTime) {
-    if (startTime >= 0.0f) {
-        float elapsedTime = deltaTime - startTime;
-        for (size_t i = 0; i < words.size(); i++) {
-            if (spawnTimes[i] <= elapsedTime) {
-                words[i].move(-speed * deltaTime, 0);
-            }
-            else {
-                spawnTimes[i] -= deltaTime;
-            }
-        }
+// Subtract the same amount from every value, one at a time, with the compiler's auto-vectorization turned off
+// Only the benchmark uses it, as the scalar baseline subtractSimd is measured against
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-tree-vectorize")))
+#endif
+void subtractScalarReference(float* values, size_t count, float amount) {
+#if defined(__clang__)
+#pragma clang loop vectorize(disable) interleave(disable) unroll(disable)
+#elif defined(_MSC_VER)
+#pragma loop(no_vector)
+#endif
+    for (size_t i = 0; i < count; i++) {
+        values[i] -= amount;
     }
 }
 
-// Set the start time to the current time
-void FloatingWords::setStartTime(float time) {
-    startTime = time;
+// Subtract the same amount from every value, 8 (AVX) or 4 (SSE2) at a time
+// Falls back to the scalar loop on other CPUs; every path rounds exactly like the scalar one
+void subtractSimd(float* values, size_t count, float amount) {
+    size_t i = 0;
+#if defined(__AVX__)
+    __m256 amounts = _mm256_set1_ps(amount);
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(values + i, _mm256_sub_ps(_mm256_loadu_ps(values + i), amounts));
+    }
+#elif defined(FLAPPY_SSE2)
+    __m128 amounts = _mm_set1_ps(amount);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(values + i, _mm_sub_ps(_mm_loadu_ps(values + i), amounts));
+    }
+#endif
+    subtractScalar(values + i, count - i, amount);
 }
 
-// Draw floating words on window if isVisible is true
-void FloatingWords::draw(sf::RenderWindow& window) const {
-    if (isVisible) {
-        for (const auto& word : words) {
-            window.draw(word);
-        }
-    }
+// Get the name of the instruction set subtractSimd was built for
+const char* getSimdName() {
+#if defined(__AVX__)
+    return "AVX";
+#elif defined(FLAPPY_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
 }
 
-// Reset floating words
-void FloatingWords::reset() {
-    words.clear();
-    spawnTimes.clear();
-
-    std::ifstream file(filePath);
-    if (file.is_open()) {
-        std::string word;
-        float currentTime = 0.0f; // Set the current time to 0
-
-        while (file >> word) { // Read each word from the file
-            sf::Text text;
-            text.setFont(font);
-            text.setString(word);
-            text.setCharacterSize(24);
-            text.setFillColor(sf::Color::White);
-            float yPosition = std::rand() % static_cast<int>(floorPosition - skyPosition - text.getGlobalBounds().height) + skyPosition; // Set the y position of the word to a random position between the sky and the floor
-            text.setPosition(windowSize.x, yPosition);
-            words.push_back(text);
-            spawnTimes.push_back(currentTime);
-            currentTime += spawnInterval;
-        }
-        file.close();
 
-    }
-}
 
-// SCORE SETUP
+// MAPPED FILE CLASS
 
-class Score {
+// MappedFile class
+// Maps a whole file read-only into memory, so reading it costs nothing until a page is touched
+class MappedFile {
 private:
+    const char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    bool open(const std::string& path);
+    void close();
+    const char* getData() const;
+    size_t getSize() const;
+};
+
+MappedFile::MappedFile()
+    : data(nullptr), size(0) {
+#ifdef _WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+// Map a file, returns false if it is missing or empty
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        close();
+        return false;
+    }
+    data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!data) {
+        close();
+        return false;
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+        ::close(descriptor);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor); // the mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<const char*>(view);
+    size = static_cast<size_t>(status.st_size);
+#endif
+    return true;
+}
+
+// Unmap the file
+void MappedFile::close() {
+#ifdef _WIN32
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+    file = INVALID_HANDLE_VALUE;
+    mapping = nullptr;
+#else
+    if (data) {
+        munmap(const_cast<char*>(data), size);
+    }
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+// Get the mapped bytes
+const char* MappedFile::getData() const {
+    return data;
+}
+
+// Get the number of mapped bytes
+size_t MappedFile::getSize() const {
+    return size;
+}
+
+
+
+// FLOATING WORDS CLASS FUNCTIONS
+
+// WordStream class
+// Reads the words of a poem one at a time, so only the words about to spawn are ever in memory
+// One word is always read ahead, so the end of the poem is known before it is reached
+class WordStream {
+private:
+    std::string filePath;
+    std::ifstream file;
+    std::string aheadWord;
+    bool hasAhead;
+
+public:
+    explicit WordStream(const std::string& filePath);
+    bool next(std::string& word);
+    bool isFinished() const;
+    void rewind();
+};
+
+// The file is opened by the first rewind
+WordStream::WordStream(const std::string& filePath)
+    : filePath(filePath), hasAhead(false) {
+}
+
+// Read the next word, returns false at the end of the poem
+bool WordStream::next(std::string& word) {
+    if (!hasAhead) {
+        return false;
+    }
+    word.swap(aheadWord);
+    hasAhead = static_cast<bool>(file >> aheadWord);
+    return true;
+}
+
+// Check if every word has been read
+bool WordStream::isFinished() const {
+    return !hasAhead;
+}
+
+// Start reading from the first word
+void WordStream::rewind() {
+    file.close();
+    file.clear();
+    file.open(filePath);
+    hasAhead = file.is_open() && static_cast<bool>(file >> aheadWord);
+}
+
+
+// WordIndex class
+// Pre-tokenized poem stored next to the text as "<poem>.idx" and mapped into memory:
+//   header, then one entry per word (offset and length of its text, bounds measured at build time), then the text
+// Loading a word is a lookup by number, so startup does not depend on the length of the poem and restarting
+// only resets the word number. The index is a local cache written in the machine's own byte order; it is
+// rebuilt from the text when the text's size or modification time changes or it was measured differently.
+// A truncated or corrupt index is rejected on open, and a word whose entry points outside the text reads as empty.
+class WordIndex {
+private:
+    struct Header {
+        char magic[4]; // "FBWI"
+        std::uint32_t version;
+        std::uint32_t measuredWithFont; // 0 when the bounds are the headless approximation
+        std::uint32_t characterSize;
+        std::uint64_t sourceSize; // size of the text the index was built from
+        std::uint64_t sourceModified; // modification time of that text, in the file system's own units
+        std::uint64_t wordCount;
+        std::uint64_t textOffset; // where the text of the words starts
+        std::uint64_t textSize; // the text runs to the end of the file
+    };
+    struct Entry {
+        std::uint32_t offset; // relative to the text
+        std::uint32_t length;
+        float left;
+        float top;
+        float width;
+        float height;
+    };
+    static const std::uint32_t version = 2;
+    MappedFile file;
+    const Entry* entries;
+    const char* text;
+    size_t textSize;
+    size_t wordCount;
+    static bool getFileStamp(const std::string& path, std::uint64_t& size, std::uint64_t& modified);
+
+public:
+    static const unsigned int characterSize = 24;
+    WordIndex();
+    bool open(const std::string& poemPath, bool measuredWithFont);
+    bool isOpen() const;
+    size_t getWordCount() const;
+    void getWord(size_t index, std::string& word) const;
+    sf::FloatRect getBounds(size_t index) const;
+    static std::string getIndexPath(const std::string& poemPath);
+    static bool build(const std::string& poemPath, const sf::Font& font, bool measuredWithFont);
+    static sf::FloatRect measureWord(const sf::Text& text, bool measuredWithFont);
+};
+
+WordIndex::WordIndex()
+    : entries(nullptr), text(nullptr), textSize(0), wordCount(0) {
+}
+
+// Get the size and modification time of a file, returns false if it is missing
+bool WordIndex::getFileStamp(const std::string& path, std::uint64_t& size, std::uint64_t& modified) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes)) {
+        return false;
+    }
+    size = (static_cast<std::uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+    modified = (static_cast<std::uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0) {
+        return false;
+    }
+    size = static_cast<std::uint64_t>(status.st_size);
+#if defined(__APPLE__)
+    modified = static_cast<std::uint64_t>(status.st_mtimespec.tv_sec) * 1000000000ull + status.st_mtimespec.tv_nsec;
+#else
+    modified = static_cast<std::uint64_t>(status.st_mtim.tv_sec) * 1000000000ull + status.st_mtim.tv_nsec;
+#endif
+#endif
+    return true;
+}
+
+// Map the index of a poem, returns false if it is missing, stale or measured differently
+bool WordIndex::open(const std::string& poemPath, bool measuredWithFont) {
+    entries = nullptr;
+    text = nullptr;
+    textSize = 0;
+    wordCount = 0;
+    std::uint64_t sourceSize = 0;
+    std::uint64_t sourceModified = 0;
+    if (!getFileStamp(poemPath, sourceSize, sourceModified) || !file.open(getIndexPath(poemPath))) {
+        return false;
+    }
+
+    Header header;
+    if (file.getSize() < sizeof(header)) {
+        file.close();
+        return false;
+    }
+    std::memcpy(&header, file.getData(), sizeof(header));
+    bool valid = std::memcmp(header.magic, "FBWI", 4) == 0
+        && header.version == version
+        && header.measuredWithFont == (measuredWithFont ? 1u : 0u)
+        && header.characterSize == characterSize
+        && header.sourceSize == sourceSize
+        && header.sourceModified == sourceModified
+        && header.wordCount <= (file.getSize() - sizeof(Header)) / sizeof(Entry)
+        && header.textOffset == sizeof(Header) + header.wordCount * sizeof(Entry)
+        && header.textOffset <= file.getSize()
+        && header.textSize == file.getSize() - header.textOffset; // a truncated file is shorter
+    if (valid && header.wordCount > 0) {
+        // Words are stored in order, so the last entry reaches furthest into the text
+        Entry last;
+        std::memcpy(&last, file.getData() + sizeof(Header) + (header.wordCount - 1) * sizeof(Entry), sizeof(Entry));
+        valid = static_cast<std::uint64_t>(last.offset) + last.length == header.textSize;
+    }
+    if (!valid) {
+        file.close();
+        return false;
+    }
+
+    entries = reinterpret_cast<const Entry*>(file.getData() + sizeof(Header));
+    text = file.getData() + header.textOffset;
+    textSize = static_cast<size_t>(header.textSize);
+    wordCount = static_cast<size_t>(header.wordCount);
+    return true;
+}
+
+// Check if an index is mapped
+bool WordIndex::isOpen() const {
+    return entries != nullptr;
+}
+
+// Get the number of words in the poem
+size_t WordIndex::getWordCount() const {
+    return wordCount;
+}
+
+// Copy the text of a word, reusing the string's memory
+// An entry pointing outside the text, which only a corrupt index has, gives an empty word
+void WordIndex::getWord(size_t index, std::string& word) const {
+    const Entry& entry = entries[index];
+    if (entry.offset > textSize || entry.length > textSize - entry.offset) {
+        word.clear();
+        return;
+    }
+    word.assign(text + entry.offset, entry.length);
+}
+
+// Get the bounds of a word measured when the index was built
+sf::FloatRect WordIndex::getBounds(size_t index) const {
+    const Entry& entry = entries[index];
+    return sf::FloatRect(entry.left, entry.top, entry.width, entry.height);
+}
+
+// Get the path of the index for a poem
+std::string WordIndex::getIndexPath(const std::string& poemPath) {
+    return poemPath + ".idx";
+}
+
+// Tokenize and measure a poem and write its index
+// The index is written to a temporary file first, so a reader never maps a half-written one
+bool WordIndex::build(const std::string& poemPath, const sf::Font& font, bool measuredWithFont) {
+    WordStream stream(poemPath);
+    stream.rewind();
+    sf::Text measured;
+    measured.setFont(font);
+    measured.setCharacterSize(characterSize);
+
+    std::vector<Entry> newEntries;
+    std::string newText;
+    std::string word;
+    while (stream.next(word)) {
+        measured.setString(word);
+        sf::FloatRect bounds = measureWord(measured, measuredWithFont);
+        Entry entry;
+        entry.offset = static_cast<std::uint32_t>(newText.size());
+        entry.length = static_cast<std::uint32_t>(word.size());
+        entry.left = bounds.left;
+        entry.top = bounds.top;
+        entry.width = bounds.width;
+        entry.height = bounds.height;
+        newEntries.push_back(entry);
+        newText += word;
+    }
+
+    Header header;
+    std::memcpy(header.magic, "FBWI", 4);
+    header.version = version;
+    header.measuredWithFont = measuredWithFont ? 1 : 0;
+    header.characterSize = characterSize;
+    if (!getFileStamp(poemPath, header.sourceSize, header.sourceModified)) {
+        std::cerr << "Error reading " << poemPath << std::endl;
+        return false;
+    }
+    header.wordCount = newEntries.size();
+    header.textOffset = sizeof(Header) + newEntries.size() * sizeof(Entry);
+    header.textSize = newText.size();
+
+    std::string indexPath = getIndexPath(poemPath);
+    std::string temporaryPath = indexPath + ".tmp";
+    {
+        std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(newEntries.data()), newEntries.size() * sizeof(Entry));
+        output.write(newText.data(), newText.size());
+        output.close(); // flushes the last writes, so a full disk shows up in the check below
+        if (!output) {
+            std::cerr << "Error writing word index " << temporaryPath << std::endl;
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    std::remove(indexPath.c_str()); // rename does not replace an existing file on Windows
+    if (std::rename(temporaryPath.c_str(), indexPath.c_str()) != 0) {
+        std::cerr << "Error writing word index " << indexPath << std::endl;
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Measure a word
+// Headless runs have no glyph texture, so they approximate Arial with an average advance of 0.55 em
+sf::FloatRect WordIndex::measureWord(const sf::Text& text, bool measuredWithFont) {
+    if (!measuredWithFont) {
+        float size = static_cast<float>(text.getCharacterSize());
+        return sf::FloatRect(0.0f, size * 0.25f, size * 0.55f * text.getString().getSize(), size * 0.75f);
+    }
+    return text.getLocalBounds();
+}
+
+
+// FloatingWords class
+// Class to display floating words on the screen
+// Words are loaded from the poem's index, or streamed from the text when there is no index, into a ring of
+// slots a few seconds ahead of their spawn, so startup time and memory do not grow with the length of the poem. Words are numbered in poem order and word i lives in
+// slot i % capacity; the numbers split into ranges:
+//   [0, activeBegin)          retired, collected or missed
+//   [activeBegin, activeEnd)  active, moving on screen; collected words in here are flagged retired
+//   [activeEnd, loadedEnd)    pending, loaded and waiting to spawn
+// Spawning, collecting and missing a word only moves a range boundary or sets a flag, no text is copied
+// Per-word data is kept as one array per field, so update and collision run over plain floats.
+// Drawing builds each word's glyph quads once, relative to the word's position, and copies them into
+// one vertex array per frame, so all words go out in a single draw call from the font's glyph page
+class FloatingWords {
+private:
+    enum class WordState : std::uint8_t { Pending, Active, Missed, Retired };
+    FontHandle font;
+    float speed;
+    float startTime;
+    double spawnClock; // seconds since the words started moving, a double so spawning keeps its cadence through days of play
+    float lastStep; // distance every active word moved in the last update
+    sf::Vector2u windowSize;
+    bool headless;
+    GameRandom& random;
+    WordIndex index;
+    WordStream stream; // only used when the poem has no usable index
+    size_t lookaheadWords; // pending words kept loaded ahead of the next spawn
+    size_t capacity; // number of slots, always a power of two
+    std::vector<std::string> texts;
+    std::vector<sf::Color> colors;
+    std::vector<std::vector<sf::Vertex>> glyphs; // glyph quads of each word relative to its position
+    std::vector<std::uint8_t> glyphsDirty; // set when a word is loaded into the slot, built on the next draw
+    sf::Text measuredText; // measures words streamed from the text
+    sf::VertexArray batch; // every word drawn this frame
+    size_t drawnCount; // words drawn and culled by the last draw
+    size_t culledCount;
+    std::vector<double> spawnTimes;
+    std::vector<float> positionsX;
+    std::vector<float> positionsY;
+    std::vector<float> offsetsX; // bounds of each word relative to its position
+    std::vector<float> offsetsY;
+    std::vector<float> widths;
+    std::vector<float> heights;
+    std::vector<WordState> states;
+    size_t activeBegin;
+    size_t activeEnd;
+    size_t loadedEnd;
+    size_t remainingCount; // loaded words that are not retired
+    float minOffsetX; // smallest left edge of the loaded words relative to their position
+    size_t slot(size_t index) const;
+    void resizeSlots(size_t newCapacity);
+    bool loadNextWord();
+    void fillLookahead();
+    void buildGlyphs(size_t slot);
+
+
+public:
+    FloatingWords(const std::string& filePath, const FontHandle& font, float speed, float spawnInterval, const sf::Vector2u& windowSize, float groundHeight, GameRandom& random, bool headless = false);
+    void update(float deltaTime);
+    void draw(sf::RenderTarget& target, float alpha = 1.0f);
+    bool isVisible;
+    void setStartTime(float time);
+    sf::FloatRect getBounds(size_t index) const; // Move this function inside the class 
+    float getHeight(size_t index) const;
+    sf::Vector2f getPosition(size_t index) const;
+    void setPosition(size_t index, const sf::Vector2f& position);
+    size_t getActiveBegin() const;
+    size_t getActiveEnd() const;
+    size_t getLoadedEnd() const;
+    bool isRetired(size_t index) const;
+    size_t getRemainingCount() const;
+    bool isFinished() const;
+    size_t getDrawnCount() const;
+    size_t getCulledCount() const;
+    bool startsRightOf(size_t index, float x) const;
+    void markMissed(size_t index);
+    void retireWord(size_t index);
+    float spawnInterval;
+    float floorPosition;
+    float skyPosition;
+    void reset();
+    sf::Color originalColor;
+};
+
+// Set up the word slots and load the first words from the file
+FloatingWords::FloatingWords(const std::string& filePath, const FontHandle& font, float speed, float spawnInterval, const sf::Vector2u& windowSize, float groundHeight, GameRandom& random, bool headless)
+    : font(font), speed(speed), startTime(-1.0f), spawnClock(0.0), lastStep(0.0f), windowSize(windowSize), headless(headless), random(random), stream(filePath), capacity(0), drawnCount(0), culledCount(0), activeBegin(0), activeEnd(0), loadedEnd(0), remainingCount(0), minOffsetX(0.0f), isVisible(false), spawnInterval(spawnInterval), floorPosition(windowSize.y + groundHeight + 60.0f), skyPosition(1.0f), originalColor(sf::Color::White) {
+    // Build the index on the first run; headless runs only build a missing one, so they never
+    // replace an index measured with the font
+    if (!index.open(filePath, !headless)) {
+        bool missing = !std::ifstream(WordIndex::getIndexPath(filePath));
+        if ((missing || !headless) && WordIndex::build(filePath, *font, !headless)) {
+            index.open(filePath, !headless);
+        }
+    }
+
+    const float lookaheadSeconds = 2.0f;
+    lookaheadWords = static_cast<size_t>(lookaheadSeconds / spawnInterval) + 1;
+
+    // Room for every word that fits on screen plus the lookahead, with a margin for long words
+    size_t wordsOnScreen = static_cast<size_t>(windowSize.x / speed / spawnInterval) + 1;
+    size_t slots = 16;
+    while (slots < 2 * (wordsOnScreen + lookaheadWords)) {
+        slots *= 2;
+    }
+    batch.setPrimitiveType(sf::Triangles);
+    measuredText.setFont(*font);
+    measuredText.setCharacterSize(WordIndex::characterSize);
+    resizeSlots(slots);
+    reset();
+}
+
+// Get the slot of a word
+size_t FloatingWords::slot(size_t index) const {
+    return index & (capacity - 1);
+}
+
+// Change the number of slots, keeping the loaded words
+void FloatingWords::resizeSlots(size_t newCapacity) {
+    std::vector<std::string> newTexts(newCapacity);
+    std::vector<sf::Color> newColors(newCapacity);
+    std::vector<std::vector<sf::Vertex>> newGlyphs(newCapacity);
+    std::vector<std::uint8_t> newGlyphsDirty(newCapacity, 1);
+    std::vector<double> newSpawnTimes(newCapacity);
+    std::vector<float> newPositionsX(newCapacity), newPositionsY(newCapacity);
+    std::vector<float> newOffsetsX(newCapacity), newOffsetsY(newCapacity), newWidths(newCapacity), newHeights(newCapacity);
+    std::vector<WordState> newStates(newCapacity, WordState::Retired);
+    for (size_t i = activeBegin; i < loadedEnd; i++) {
+        size_t from = slot(i);
+        size_t to = i & (newCapacity - 1);
+        newTexts[to].swap(texts[from]);
+        newColors[to] = colors[from];
+        newGlyphs[to].swap(glyphs[from]);
+        newGlyphsDirty[to] = glyphsDirty[from];
+        newSpawnTimes[to] = spawnTimes[from];
+        newPositionsX[to] = positionsX[from];
+        newPositionsY[to] = positionsY[from];
+        newOffsetsX[to] = offsetsX[from];
+        newOffsetsY[to] = offsetsY[from];
+        newWidths[to] = widths[from];
+        newHeights[to] = heights[from];
+        newStates[to] = states[from];
+    }
+    texts.swap(newTexts);
+    colors.swap(newColors);
+    glyphs.swap(newGlyphs);
+    glyphsDirty.swap(newGlyphsDirty);
+    spawnTimes.swap(newSpawnTimes);
+    positionsX.swap(newPositionsX);
+    positionsY.swap(newPositionsY);
+    offsetsX.swap(newOffsetsX);
+    offsetsY.swap(newOffsetsY);
+    widths.swap(newWidths);
+    heights.swap(newHeights);
+    states.swap(newStates);
+    capacity = newCapacity;
+}
+
+// Load the next word of the poem into a free slot, returns false at the end of the poem
+bool FloatingWords::loadNextWord() {
+    if (index.isOpen() ? loadedEnd == index.getWordCount() : stream.isFinished()) {
+        return false;
+    }
+    TRACE_SCOPE("word spawn");
+    if (loadedEnd - activeBegin == capacity) {
+        resizeSlots(capacity * 2); // only happens when words pile up faster than they retire
+    }
+
+    size_t i = slot(loadedEnd);
+    sf::FloatRect bounds;
+    if (index.isOpen()) {
+        index.getWord(loadedEnd, texts[i]);
+        bounds = index.getBounds(loadedEnd);
+    }
+    else {
+        stream.next(texts[i]);
+        measuredText.setString(texts[i]);
+        bounds = WordIndex::measureWord(measuredText, !headless);
+    }
+    colors[i] = originalColor;
+    glyphsDirty[i] = 1;
+    float yPosition = random.next(static_cast<int>(floorPosition - skyPosition - bounds.height)) + skyPosition; // Set the y position of the word to a random position between the sky and the floor
+    spawnTimes[i] = loadedEnd * static_cast<double>(spawnInterval);
+    positionsX[i] = static_cast<float>(windowSize.x);
+    positionsY[i] = yPosition;
+    offsetsX[i] = bounds.left;
+    offsetsY[i] = bounds.top;
+    widths[i] = bounds.width;
+    heights[i] = bounds.height;
+    states[i] = WordState::Pending;
+    minOffsetX = std::min(minOffsetX, bounds.left);
+    loadedEnd++;
+    remainingCount++;
+    return true;
+}
+
+// Keep the next few seconds of words loaded
+void FloatingWords::fillLookahead() {
+    while (loadedEnd - activeEnd < lookaheadWords && loadNextWord()) {
+    }
+}
+
+// Get the bounds of the floating words
+// Uses the bounds measured by the index or on load, since the words are only ever moved and never scaled or rotated
+sf::FloatRect FloatingWords::getBounds(size_t index) const {
+    size_t i = slot(index);
+    return sf::FloatRect(positionsX[i] + offsetsX[i], positionsY[i] + offsetsY[i], widths[i], heights[i]);
+}
+
+// Get the height of a floating word
+float FloatingWords::getHeight(size_t index) const {
+    return heights[slot(index)];
+}
+
+// Get the position of a floating word
+sf::Vector2f FloatingWords::getPosition(size_t index) const {
+    return sf::Vector2f(positionsX[slot(index)], positionsY[slot(index)]);
+}
+
+// Set the position of a floating word
+void FloatingWords::setPosition(size_t index, const sf::Vector2f& position) {
+    positionsX[slot(index)] = position.x;
+    positionsY[slot(index)] = position.y;
+}
+
+// Get the first word of the active range
+// Words spawn in order and all move at the same speed, so the active range is sorted from left to right
+size_t FloatingWords::getActiveBegin() const {
+    return activeBegin;
+}
+
+// Get the end of the active range, which is also the next word to spawn
+size_t FloatingWords::getActiveEnd() const {
+    return activeEnd;
+}
+
+// Get the end of the loaded words
+size_t FloatingWords::getLoadedEnd() const {
+    return loadedEnd;
+}
+
+// Check if a word has been collected or missed
+bool FloatingWords::isRetired(size_t index) const {
+    return states[slot(index)] == WordState::Retired;
+}
+
+// Get the number of loaded words that are still active or pending
+size_t FloatingWords::getRemainingCount() const {
+    return remainingCount;
+}
+
+// Check if every word of the poem has been collected or missed
+bool FloatingWords::isFinished() const {
+    return remainingCount == 0 && (index.isOpen() ? loadedEnd == index.getWordCount() : stream.isFinished());
+}
+
+// Check if a word, and so every active word after it, lies entirely right of x
+bool FloatingWords::startsRightOf(size_t index, float x) const {
+    return positionsX[slot(index)] + minOffsetX >= x;
+}
+
+// Turn a word the bird has passed red, once
+void FloatingWords::markMissed(size_t index) {
+    size_t i = slot(index);
+    if (states[i] == WordState::Active) {
+        states[i] = WordState::Missed;
+        colors[i] = sf::Color::Red;
+        for (sf::Vertex& vertex : glyphs[i]) {
+            vertex.color = colors[i]; // recolor in place, the quads stay the same
+        }
+    }
+}
+
+// Retire a collected or missed word, which frees its slot once the words before it are retired too
+// Missed words leave from the left end of the active range, which then skips past every retired word
+void FloatingWords::retireWord(size_t index) {
+    if (states[slot(index)] == WordState::Retired) {
+        return;
+    }
+    states[slot(index)] = WordState::Retired;
+    remainingCount--;
+    while (activeBegin < activeEnd && states[slot(activeBegin)] == WordState::Retired) {
+        activeBegin++;
+    }
+}
+
+// Update floating words position by moving them to the left
+// if the start time is greater than 0, move the words to the left
+void FloatingWords::update(float deltaTime) {
+    if (startTime >= 0.0f) {
+        double elapsedTime = deltaTime - startTime;
+        fillLookahead();
+
+        // Pending words spawn in poem order, so the spawned-vs-pending mask is always a single boundary:
+        // the ones that are due extend the active range
+        while (activeEnd < loadedEnd && spawnTimes[slot(activeEnd)] - spawnClock <= elapsedTime) {
+            states[slot(activeEnd)] = WordState::Active;
+            activeEnd++;
+        }
+        spawnClock += deltaTime;
+
+        // Retired words inside the active range move too, which keeps the loop free of branches
+        // The range wraps around the end of the slots at most once
+        float step = speed * deltaTime;
+        lastStep = step;
+        size_t first = slot(activeBegin);
+        size_t count = activeEnd - activeBegin;
+        size_t untilWrap = std::min(count, capacity - first);
+        subtractSimd(positionsX.data() + first, untilWrap, step);
+        subtractSimd(positionsX.data(), count - untilWrap, step);
+
+        // Words that scrolled off the left edge without being collected or missed, while the words are hidden
+        while (activeBegin < activeEnd && positionsX[slot(activeBegin)] + offsetsX[slot(activeBegin)] + widths[slot(activeBegin)] < 0.0f) {
+            retireWord(activeBegin);
+        }
+    }
+}
+
+// Set the start time to the current time
+void FloatingWords::setStartTime(float time) {
+    startTime = time;
+}
+
+// Build the glyph quads of a word, laid out like sf::Text with the baseline one character size down
+// Glyphs need the font's glyph texture, so this only runs when drawing
+void FloatingWords::buildGlyphs(size_t slot) {
+    const float padding = 1.0f; // sf::Text pads every glyph to avoid cutting off smoothed edges
+    const unsigned int characterSize = WordIndex::characterSize;
+    std::vector<sf::Vertex>& vertices = glyphs[slot];
+    vertices.clear();
+
+    float x = 0.0f;
+    float y = static_cast<float>(characterSize);
+    sf::Uint32 previous = 0;
+    for (char character : texts[slot]) {
+        sf::Uint32 codePoint = static_cast<unsigned char>(character);
+        x += font->getKerning(previous, codePoint, characterSize);
+        previous = codePoint;
+
+        const sf::Glyph& glyph = font->getGlyph(codePoint, characterSize, false);
+        float left = glyph.bounds.left - padding;
+        float top = glyph.bounds.top - padding;
+        float right = glyph.bounds.left + glyph.bounds.width + padding;
+        float bottom = glyph.bounds.top + glyph.bounds.height + padding;
+        float u1 = static_cast<float>(glyph.textureRect.left) - padding;
+        float v1 = static_cast<float>(glyph.textureRect.top) - padding;
+        float u2 = static_cast<float>(glyph.textureRect.left + glyph.textureRect.width) + padding;
+        float v2 = static_cast<float>(glyph.textureRect.top + glyph.textureRect.height) + padding;
+
+        vertices.push_back(sf::Vertex(sf::Vector2f(x + left, y + top), colors[slot], sf::Vector2f(u1, v1)));
+        vertices.push_back(sf::Vertex(sf::Vector2f(x + right, y + top), colors[slot], sf::Vector2f(u2, v1)));
+        vertices.push_back(sf::Vertex(sf::Vector2f(x + left, y + bottom), colors[slot], sf::Vector2f(u1, v2)));
+        vertices.push_back(sf::Vertex(sf::Vector2f(x + left, y + bottom), colors[slot], sf::Vector2f(u1, v2)));
+        vertices.push_back(sf::Vertex(sf::Vector2f(x + right, y + top), colors[slot], sf::Vector2f(u2, v1)));
+        vertices.push_back(sf::Vertex(sf::Vector2f(x + right, y + bottom), colors[slot], sf::Vector2f(u2, v2)));
+
+        x += glyph.advance;
+    }
+    glyphsDirty[slot] = 0;
+}
+
+// Get the number of words the last draw submitted
+size_t FloatingWords::getDrawnCount() const {
+    return drawnCount;
+}
+
+// Get the number of loaded words the last draw skipped because they were outside the view
+size_t FloatingWords::getCulledCount() const {
+    return culledCount;
+}
+
+// Draw floating words on window if isVisible is true, alpha of the way through the last step
+// Words spawn at the right edge and all move by the same step, so a word's previous position is always
+// one step right of its current one, including words that spawned in the last update.
+// Only active words inside the view are submitted: pending words wait right of the window and the active
+// range is sorted from left to right, so the loop stops at the first word past the right edge.
+// Only words loaded since the last draw build their glyphs; the rest are copied at their position
+void FloatingWords::draw(sf::RenderTarget& target, float alpha) {
+    drawnCount = 0;
+    culledCount = 0;
+    if (isVisible) {
+        float lag = (1.0f - alpha) * lastStep;
+        sf::FloatRect visibleArea = getVisibleArea(target);
+        visibleArea.left -= lag; // test the words where they are drawn
+        batch.clear();
+        for (size_t index = activeBegin; index < activeEnd; index++) {
+            size_t i = slot(index);
+            if (startsRightOf(index, visibleArea.left + visibleArea.width)) {
+                break;
+            }
+            if (states[i] != WordState::Retired && getBounds(index).intersects(visibleArea)) {
+                if (glyphsDirty[i]) {
+                    buildGlyphs(i);
+                }
+                drawnCount++;
+                for (const sf::Vertex& glyphVertex : glyphs[i]) {
+                    sf::Vertex vertex = glyphVertex;
+                    vertex.position.x += positionsX[i] + lag;
+                    vertex.position.y += positionsY[i];
+                    batch.append(vertex);
+                }
+            }
+        }
+        culledCount = remainingCount - drawnCount;
+        // The glyph page is fetched after building, since new glyphs can grow it
+        target.draw(batch, sf::RenderStates(&font->getTexture(WordIndex::characterSize)));
+    }
+}
+
+// Reset floating words to the start of the poem
+// With an index this only resets the word numbers; the text is read again from the start otherwise
+void FloatingWords::reset() {
+    std::fill(states.begin(), states.end(), WordState::Retired);
+    activeBegin = 0;
+    activeEnd = 0;
+    loadedEnd = 0;
+    remainingCount = 0;
+    spawnClock = 0.0;
+    lastStep = 0.0f;
+    minOffsetX = 0.0f;
+    if (!index.isOpen()) {
+        stream.rewind();
+    }
+    fillLookahead();
+}
+
+// SCORE SETUP
+
+class Score {
+private:
+    FontHandle font;
     int value;
     int multiplier;
     sf::Text scoreText;
     sf::Text livesText;
+    int shownValue; // values the texts show, so they are only formatted again when one changes
+    int shownLives;
+    bool layoutDirty;
 
 public:
-    Score(const sf::Font& font, const sf::Vector2f& position);
+    Score(const FontHandle& font, const sf::Vector2f& position);
     void increment(int amount);
     void decrement(int amount);
     void incrementMultiplier();
@@ -765,20 +2558,20 @@ public:
     void resetLives();
     void reset();
     void update();
-    void draw(sf::RenderWindow& window) const;
+    void draw(sf::RenderTarget& target);
     int getValue() const;
     bool isVisible;
     int lives;
 };
 
-Score::Score(const sf::Font& font, const sf::Vector2f& position)
-    : value(0), multiplier(1), lives(3), isVisible(true) {
-    scoreText.setFont(font);
+Score::Score(const FontHandle& font, const sf::Vector2f& position)
+    : font(font), value(0), multiplier(1), shownValue(-1), shownLives(-1), layoutDirty(true), isVisible(true), lives(3) {
+    scoreText.setFont(*font);
     scoreText.setCharacterSize(24);
     scoreText.setFillColor(sf::Color::White);
     scoreText.setPosition(position);
 
-    livesText.setFont(font);
+    livesText.setFont(*font);
     livesText.setCharacterSize(24);
     livesText.setFillColor(sf::Color::White);
 }
@@ -816,17 +2609,35 @@ void Score::resetLives() {
     lives = 3;
 }
 
+// Format the texts into a fixed buffer, only when the score or lives changed since the last update
+// Most ticks change neither, so they set no strings and make no heap allocations
 void Score::update() {
-    scoreText.setString("Score: " + std::to_string(value));
-    livesText.setString(" Lifes: " + std::to_string(lives));
-    sf::FloatRect scoreBounds = scoreText.getGlobalBounds();
-    livesText.setPosition(scoreBounds.left + scoreBounds.width + 10.0f, scoreText.getPosition().y);
+    if (value == shownValue && lives == shownLives) {
+        return;
+    }
+    char buffer[32];
+    if (value != shownValue) {
+        std::snprintf(buffer, sizeof(buffer), "Score: %d", value);
+        scoreText.setString(buffer);
+        shownValue = value;
+        layoutDirty = true; // lives text is placed next to the score on the next draw
+    }
+    if (lives != shownLives) {
+        std::snprintf(buffer, sizeof(buffer), " Lifes: %d", lives);
+        livesText.setString(buffer);
+        shownLives = lives;
+    }
 }
 
-void Score::draw(sf::RenderWindow& window) const {
+void Score::draw(sf::RenderTarget& target) {
     if (isVisible) {
-        window.draw(scoreText);
-        window.draw(livesText);
+        if (layoutDirty) {
+            sf::FloatRect scoreBounds = scoreText.getGlobalBounds();
+            livesText.setPosition(scoreBounds.left + scoreBounds.width + 10.0f, scoreText.getPosition().y);
+            layoutDirty = false;
+        }
+        target.draw(scoreText);
+        target.draw(livesText);
     }
 }
 
@@ -835,89 +2646,685 @@ int Score::getValue() const {
 }
 
 
+// INPUT RECORDING CLASS
+
+// Input events captured with the tick they were handled at, plus the seed and tick rate of the game
+// Replaying a recording with the same seed, tick rate and word measurement gives the same game tick by tick.
+// Word heights decide where words spawn, so a recording made with words measured with the font (any game with
+// OpenGL) is replayed offscreen with the font, and one made headless is replayed headless.
+//
+// File layout (little endian):
+//   "FBIR", version byte, seed (4 bytes), ticks per second (varint, version 2 and later; 60 before)
+//   flags byte (version 3 and later; 0 before): bit 0 set when words were measured with the font
+//   per event: tick delta (varint), kind byte, key code or character (varint)
+//   end marker: tick delta to the last tick (varint), kind 0xFF
+class InputRecording {
+private:
+    enum Kind : std::uint8_t { KeyPressed = 0, TextEntered = 1, Closed = 2, End = 0xFF };
+    enum Flags : std::uint8_t { MeasuredWithFont = 1 };
+    static const std::uint8_t version = 3;
+    std::vector<std::pair<std::uint64_t, sf::Event>> events;
+    std::uint32_t seed;
+    std::uint32_t tickRate;
+    bool measuredWithFont;
+    std::uint64_t endTick;
+
+    static void writeVarint(std::ostream& out, std::uint64_t value);
+    static bool readVarint(std::istream& in, std::uint64_t& value);
+
+public:
+    explicit InputRecording(std::uint32_t seed = 0, std::uint32_t tickRate = 60, bool measuredWithFont = false);
+    static bool isRecorded(const sf::Event& event);
+    void record(std::uint64_t tick, const sf::Event& event);
+    void setEndTick(std::uint64_t tick);
+    bool saveToFile(const std::string& path) const;
+    bool loadFromFile(const std::string& path);
+    const std::vector<std::pair<std::uint64_t, sf::Event>>& getEvents() const;
+    std::uint32_t getSeed() const;
+    std::uint32_t getTickRate() const;
+    bool isMeasuredWithFont() const;
+    std::uint64_t getEndTick() const;
+};
+
+InputRecording::InputRecording(std::uint32_t seed, std::uint32_t tickRate, bool measuredWithFont)
+    : seed(seed), tickRate(tickRate), measuredWithFont(measuredWithFont), endTick(0) {
+}
+
+// Only the inputs the game reacts to are recorded: Space, Enter, S, typed characters and closing the window
+bool InputRecording::isRecorded(const sf::Event& event) {
+    if (event.type == sf::Event::KeyPressed) {
+        return event.key.code == sf::Keyboard::Space || event.key.code == sf::Keyboard::Enter || event.key.code == sf::Keyboard::S;
+    }
+    return event.type == sf::Event::TextEntered || event.type == sf::Event::Closed;
+}
+
+// Add an event handled at the given tick
+void InputRecording::record(std::uint64_t tick, const sf::Event& event) {
+    events.push_back(std::make_pair(tick, event));
+    endTick = std::max(endTick, tick);
+}
+
+// Set the tick the recording ends at, so a replay runs as long as the recorded game
+void InputRecording::setEndTick(std::uint64_t tick) {
+    endTick = std::max(endTick, tick);
+}
+
+// Write a number 7 bits at a time, most ticks and key codes fit in one byte
+void InputRecording::writeVarint(std::ostream& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.put(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.put(static_cast<char>(value));
+}
+
+// Read a number written by writeVarint
+bool InputRecording::readVarint(std::istream& in, std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == EOF) {
+            return false;
+        }
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Save the recording to a binary file
+bool InputRecording::saveToFile(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write("FBIR", 4);
+    file.put(static_cast<char>(version));
+    for (int i = 0; i < 4; i++) {
+        file.put(static_cast<char>((seed >> (8 * i)) & 0xFF));
+    }
+    writeVarint(file, tickRate);
+    file.put(static_cast<char>(measuredWithFont ? MeasuredWithFont : 0));
+
+    std::uint64_t previousTick = 0;
+    for (const auto& entry : events) {
+        const sf::Event& event = entry.second;
+        writeVarint(file, entry.first - previousTick);
+        previousTick = entry.first;
+        if (event.type == sf::Event::KeyPressed) {
+            file.put(static_cast<char>(KeyPressed));
+            writeVarint(file, static_cast<std::uint64_t>(event.key.code));
+        }
+        else if (event.type == sf::Event::TextEntered) {
+            file.put(static_cast<char>(TextEntered));
+            writeVarint(file, event.text.unicode);
+        }
+        else {
+            file.put(static_cast<char>(Closed));
+            writeVarint(file, 0);
+        }
+    }
+    writeVarint(file, endTick - previousTick);
+    file.put(static_cast<char>(End));
+    return static_cast<bool>(file);
+}
+
+// Load a recording saved with saveToFile
+bool InputRecording::loadFromFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[4];
+    if (!file.read(magic, 4) || std::string(magic, 4) != "FBIR") {
+        return false;
+    }
+    int fileVersion = file.get();
+    if (fileVersion < 1 || fileVersion > version) {
+        return false;
+    }
+    seed = 0;
+    for (int i = 0; i < 4; i++) {
+        int byte = file.get();
+        if (byte == EOF) {
+            return false;
+        }
+        seed |= static_cast<std::uint32_t>(byte) << (8 * i);
+    }
+    tickRate = 60; // recordings before version 2 always ran at 60 ticks per second
+    if (fileVersion >= 2) {
+        std::uint64_t rate;
+        if (!readVarint(file, rate) || rate == 0) {
+            return false;
+        }
+        tickRate = static_cast<std::uint32_t>(rate);
+    }
+    measuredWithFont = false; // recordings before version 3 are replayed headless
+    if (fileVersion >= 3) {
+        int flags = file.get();
+        if (flags == EOF) {
+            return false;
+        }
+        measuredWithFont = (flags & MeasuredWithFont) != 0;
+    }
+
+    events.clear();
+    std::uint64_t tick = 0;
+    std::uint64_t delta;
+    while (readVarint(file, delta)) {
+        tick += delta;
+        int kind = file.get();
+        if (kind == End) {
+            endTick = tick;
+            return true;
+        }
+        std::uint64_t payload;
+        if (kind == EOF || !readVarint(file, payload)) {
+            return false;
+        }
+        sf::Event event;
+        if (kind == KeyPressed) {
+            event.type = sf::Event::KeyPressed;
+            event.key.code = static_cast<sf::Keyboard::Key>(payload);
+            event.key.alt = event.key.control = event.key.shift = event.key.system = false;
+        }
+        else if (kind == TextEntered) {
+            event.type = sf::Event::TextEntered;
+            event.text.unicode = static_cast<sf::Uint32>(payload);
+        }
+        else {
+            event.type = sf::Event::Closed;
+        }
+        events.push_back(std::make_pair(tick, event));
+    }
+    return false; // missing end marker, the file was cut short
+}
+
+// Get the recorded events in tick order
+const std::vector<std::pair<std::uint64_t, sf::Event>>& InputRecording::getEvents() const {
+    return events;
+}
+
+// Get the seed of the recorded game
+std::uint32_t InputRecording::getSeed() const {
+    return seed;
+}
+
+// Get the ticks per second of the recorded game
+std::uint32_t InputRecording::getTickRate() const {
+    return tickRate;
+}
+
+// Whether the recorded game measured words with the font, which needs OpenGL to replay
+bool InputRecording::isMeasuredWithFont() const {
+    return measuredWithFont;
+}
+
+// Get the last tick of the recorded game
+std::uint64_t InputRecording::getEndTick() const {
+    return endTick;
+}
+
+
+
+// PROFILER
+
+// Scoped timers are compiled into debug builds; define FLAPPY_PROFILER to keep them in a release build
+#if !defined(NDEBUG) && !defined(FLAPPY_PROFILER)
+#define FLAPPY_PROFILER
+#endif
+
+// Parts of a frame that are timed
+enum class ProfilePhase : std::uint8_t {
+    ProcessEvents,
+    Bird,
+    Background,
+    Ground,
+    FloatingWords,
+    Clouds,
+    Collision,
+    Score,
+    Render,
+    Count
+};
+
+// Rolling per-phase timings of the last frames
+// A phase that runs several times in a frame, like the update phases when a frame runs two ticks, adds up
+class Profiler {
+public:
+    static const size_t phaseCount = static_cast<size_t>(ProfilePhase::Count);
+    static const size_t historySize = 120; // frames
+    struct Summary {
+        float min; // microseconds
+        float average;
+        float p99;
+    };
+
+private:
+    std::int64_t current[phaseCount]; // nanoseconds spent in each phase this frame
+    std::int64_t history[phaseCount][historySize];
+    std::int64_t frameHistory[historySize]; // nanoseconds between the ends of two frames
+    size_t cursor;
+    size_t frameCount;
+    std::chrono::steady_clock::time_point lastFrameEnd;
+    static Summary summarize(const std::int64_t* samples, size_t count);
+
+public:
+    Profiler();
+    void add(ProfilePhase phase, std::int64_t nanoseconds);
+    void endFrame();
+    void skipFrame();
+    Summary getSummary(ProfilePhase phase) const;
+    Summary getFrameSummary() const;
+    size_t getFrameCount() const;
+    std::int64_t getFrameTime(size_t framesAgo) const;
+    static const char* getPhaseName(ProfilePhase phase);
+};
+
+const size_t Profiler::phaseCount;
+const size_t Profiler::historySize;
+
+Profiler::Profiler()
+    : cursor(0), frameCount(0), lastFrameEnd(std::chrono::steady_clock::now()) {
+    std::fill(current, current + phaseCount, 0);
+}
+
+// Add time spent in a phase to the current frame
+void Profiler::add(ProfilePhase phase, std::int64_t nanoseconds) {
+    current[static_cast<size_t>(phase)] += nanoseconds;
+}
+
+// Store the current frame in the history and start the next one
+void Profiler::endFrame() {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (size_t phase = 0; phase < phaseCount; phase++) {
+        history[phase][cursor] = current[phase];
+        current[phase] = 0;
+    }
+    frameHistory[cursor] = std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastFrameEnd).count();
+    lastFrameEnd = now;
+    cursor = (cursor + 1) % historySize;
+    frameCount = std::min(frameCount + 1, historySize);
+}
+
+// Drop the current frame, so time spent without drawing a frame is not counted in the next one
+void Profiler::skipFrame() {
+    std::fill(current, current + phaseCount, 0);
+    lastFrameEnd = std::chrono::steady_clock::now();
+}
+
+// Get the min, average and 99th percentile of samples in microseconds
+Profiler::Summary Profiler::summarize(const std::int64_t* samples, size_t count) {
+    Summary summary = { 0.0f, 0.0f, 0.0f };
+    if (count == 0) {
+        return summary;
+    }
+    std::int64_t sorted[historySize];
+    std::copy(samples, samples + count, sorted);
+    std::sort(sorted, sorted + count);
+    std::int64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += sorted[i];
+    }
+    summary.min = sorted[0] / 1000.0f;
+    summary.average = total / 1000.0f / count;
+    summary.p99 = sorted[std::min(count - 1, count * 99 / 100)] / 1000.0f;
+    return summary;
+}
+
+// Get the timings of a phase over the stored frames
+Profiler::Summary Profiler::getSummary(ProfilePhase phase) const {
+    return summarize(history[static_cast<size_t>(phase)], frameCount);
+}
+
+// Get the whole frame times over the stored frames
+Profiler::Summary Profiler::getFrameSummary() const {
+    return summarize(frameHistory, frameCount);
+}
+
+// Get the number of stored frames
+size_t Profiler::getFrameCount() const {
+    return frameCount;
+}
+
+// Get the time of a stored frame, 0 is the last one
+std::int64_t Profiler::getFrameTime(size_t framesAgo) const {
+    return frameHistory[(cursor + historySize - 1 - framesAgo) % historySize];
+}
+
+// Get the name a phase is shown with
+const char* Profiler::getPhaseName(ProfilePhase phase) {
+    switch (phase) {
+    case ProfilePhase::ProcessEvents: return "processEvents";
+    case ProfilePhase::Bird: return "bird";
+    case ProfilePhase::Background: return "background";
+    case ProfilePhase::Ground: return "ground";
+    case ProfilePhase::FloatingWords: return "floatingWords";
+    case ProfilePhase::Clouds: return "handleClouds";
+    case ProfilePhase::Collision: return "collision";
+    case ProfilePhase::Score: return "score";
+    case ProfilePhase::Render: return "render";
+    default: return "";
+    }
+}
+
+// ScopedTimer class
+// Adds the time from its construction to the end of its scope to a phase
+class ScopedTimer {
+private:
+    Profiler& profiler;
+    ProfilePhase phase;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    ScopedTimer(Profiler& profiler, ProfilePhase phase);
+    ~ScopedTimer();
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+ScopedTimer::ScopedTimer(Profiler& profiler, ProfilePhase phase)
+    : profiler(profiler), phase(phase), start(std::chrono::steady_clock::now()) {
+}
+
+ScopedTimer::~ScopedTimer() {
+    profiler.add(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+// Time the rest of the enclosing scope, or nothing when the profiler is compiled out
+#ifdef FLAPPY_PROFILER
+#define PROFILE_SCOPE(profiler, phase) ScopedTimer profileScope(profiler, phase)
+#else
+#define PROFILE_SCOPE(profiler, phase)
+#endif
+
+// ProfilerOverlay class
+// Table of the phase timings and a graph of the last frame times, toggled with F3
+class ProfilerOverlay {
+private:
+    FontHandle font;
+    sf::RectangleShape backgroundBox;
+    sf::Text text;
+    sf::VertexArray graph;
+    float frameBudget; // milliseconds per frame the graph marks
+    unsigned int framesUntilRefresh;
+    void refreshText(const Profiler& profiler);
+
+public:
+    ProfilerOverlay(const FontHandle& font, float frameBudget);
+    void draw(sf::RenderTarget& target, const Profiler& profiler);
+    bool isVisible;
+};
+
+ProfilerOverlay::ProfilerOverlay(const FontHandle& font, float frameBudget)
+    : font(font), graph(sf::Triangles), frameBudget(frameBudget), framesUntilRefresh(0), isVisible(false) {
+    backgroundBox.setSize(sf::Vector2f(440.0f, 330.0f));
+    backgroundBox.setFillColor(sf::Color(0, 0, 0, 190));
+    backgroundBox.setPosition(10.0f, 10.0f);
+
+    text.setFont(*font);
+    text.setCharacterSize(14);
+    text.setFillColor(sf::Color::White);
+    text.setPosition(20.0f, 16.0f);
+}
+
+// Rebuild the table of phase timings
+void ProfilerOverlay::refreshText(const Profiler& profiler) {
+    std::ostringstream table;
+    table << std::fixed << std::setprecision(1);
+    table << std::left << std::setw(16) << "phase (us)" << std::right
+        << std::setw(10) << "min" << std::setw(10) << "avg" << std::setw(10) << "p99" << "\n";
+    for (size_t phase = 0; phase < Profiler::phaseCount; phase++) {
+        Profiler::Summary summary = profiler.getSummary(static_cast<ProfilePhase>(phase));
+        table << std::left << std::setw(16) << Profiler::getPhaseName(static_cast<ProfilePhase>(phase)) << std::right
+            << std::setw(10) << summary.min << std::setw(10) << summary.average << std::setw(10) << summary.p99 << "\n";
+    }
+    Profiler::Summary frames = profiler.getFrameSummary();
+    table << std::left << std::setw(16) << "frame (ms)" << std::right << std::setprecision(2)
+        << std::setw(10) << frames.min / 1000.0f << std::setw(10) << frames.average / 1000.0f << std::setw(10) << frames.p99 / 1000.0f;
+    text.setString(table.str());
+}
+
+// Draw the overlay; the table is refreshed twice a second so it can be read, the graph every frame
+void ProfilerOverlay::draw(sf::RenderTarget& target, const Profiler& profiler) {
+    if (!isVisible) {
+        return;
+    }
+    if (framesUntilRefresh == 0) {
+        refreshText(profiler);
+        framesUntilRefresh = 30;
+    }
+    framesUntilRefresh--;
+
+    // One bar per frame, newest on the right, 4 pixels per millisecond; bars over the budget are red
+    const float pixelsPerMillisecond = 4.0f;
+    const float barWidth = 420.0f / Profiler::historySize;
+    const float bottom = 330.0f;
+    graph.clear();
+    for (size_t i = 0; i < profiler.getFrameCount(); i++) {
+        float milliseconds = profiler.getFrameTime(i) / 1000000.0f;
+        float height = std::min(milliseconds * pixelsPerMillisecond, 100.0f);
+        float left = 20.0f + (Profiler::historySize - 1 - i) * barWidth;
+        sf::Color color = milliseconds > frameBudget ? sf::Color::Red : sf::Color::Green;
+        graph.append(sf::Vertex(sf::Vector2f(left, bottom - height), color));
+        graph.append(sf::Vertex(sf::Vector2f(left + barWidth, bottom - height), color));
+        graph.append(sf::Vertex(sf::Vector2f(left + barWidth, bottom), color));
+        graph.append(sf::Vertex(sf::Vector2f(left, bottom - height), color));
+        graph.append(sf::Vertex(sf::Vector2f(left + barWidth, bottom), color));
+        graph.append(sf::Vertex(sf::Vector2f(left, bottom), color));
+    }
+    float budgetY = bottom - frameBudget * pixelsPerMillisecond; // line marking the frame budget
+    graph.append(sf::Vertex(sf::Vector2f(20.0f, budgetY - 1.0f), sf::Color::White));
+    graph.append(sf::Vertex(sf::Vector2f(440.0f, budgetY - 1.0f), sf::Color::White));
+    graph.append(sf::Vertex(sf::Vector2f(440.0f, budgetY), sf::Color::White));
+    graph.append(sf::Vertex(sf::Vector2f(20.0f, budgetY - 1.0f), sf::Color::White));
+    graph.append(sf::Vertex(sf::Vector2f(440.0f, budgetY), sf::Color::White));
+    graph.append(sf::Vertex(sf::Vector2f(20.0f, budgetY), sf::Color::White));
+
+    target.draw(backgroundBox);
+    target.draw(text);
+    target.draw(graph);
+}
+
+
+
 // GAME SETUP 
 
+// How the game is presented
+enum class GameMode {
+    Windowed,  // window, audio and rendering
+    Offscreen, // textures and fonts for drawing into an sf::RenderTexture, but no window or audio
+    Headless   // no window, OpenGL context or audio device
+};
+
+// How a windowed game paces its frames
+enum class FramePacing {
+    Uncapped, // draw as fast as possible
+    Capped,   // draw at most frameLimit frames per second, waiting out the rest of each frame
+    VSync     // let the driver wait for the display's refresh
+};
+
+// What a windowed game does with ticks it has no time left to run in a frame
+enum class CatchUpPolicy {
+    Dilate, // run them over the next frames, so game time slows down and then catches up
+    Drop    // skip them, so game time falls behind real time
+};
+
+// Settings a game is created with
+struct GameOptions {
+    GameMode mode = GameMode::Windowed;
+    std::uint32_t seed = 0;
+    std::uint32_t tickRate = 60; // fixed simulation steps per second, 60, 120 and 240 play the same
+    FramePacing framePacing = FramePacing::Capped;
+    std::uint32_t frameLimit = 60; // frames per second when capped
+    std::uint32_t maxCatchUpSteps = 5; // ticks run at most per frame
+    CatchUpPolicy catchUpPolicy = CatchUpPolicy::Dilate;
+    std::string poemPath = "assets/James Henry - Pigeons.txt";
+    std::string tracePath = "trace.json"; // where F4 saves the recorded trace
+};
+
+// Ticks a windowed game could not run in the frame they came due
+struct StepStats {
+    std::uint64_t clampedSteps = 0; // over a frame's catch-up budget and moved to later frames
+    std::uint64_t droppedSteps = 0; // never run
+};
+
+// Objects drawn and culled by the last Game::draw
+struct RenderStats {
+    size_t wordsDrawn = 0;
+    size_t wordsCulled = 0;
+    size_t cloudsDrawn = 0;
+    size_t cloudsCulled = 0;
+};
+
 // Game Class
 class Game {
+    friend class GameBenchmark;
+
 private:
-    sf::RenderWindow window;
+    bool headless;
+    AssetRegistry assets; // declared before everything that takes handles from it
+    GameRandom random;
+    sf::Vector2u windowSize;
+    std::unique_ptr<sf::RenderWindow> window; // only created in windowed mode
+    bool isOpen;
     Bird bird;
     ScrollingBackground background;
     ScrollingGround ground;
     bool firstSpacePress;
-    const float frameRate = 60.0f;
+    const std::uint32_t tickRate; // fixed simulation steps per second
+    const float tickStep; // seconds per simulation step
+    FramePacing framePacing;
+    std::uint32_t frameLimit;
+    bool redrawNeeded; // set by input while idling on a static screen
+    std::uint32_t maxCatchUpSteps;
+    CatchUpPolicy catchUpPolicy;
+    StepStats stepStats;
     StartScreen startScreen;
     FloatingWords floatingWords;
     float gameStartTime;
-    sf::Clock gameClock;
+    float gameTime; // simulated seconds since the game clock was last restarted
+    std::uint64_t boundsContactTicks; // ticks the bird spent touching the top or the ground, which cost a point every 1/60 s
     ExitScreen exitScreen;
     Score score;
     ScoreBoard scoreBoard;
     SaveScoreScreen saveScoreScreen;
-    sf::Texture cloudTexture;
+    TextureHandle cloudTexture;
     std::vector<sf::Sprite> clouds;
-    sf::Music backgroundMusic;
-    sf::SoundBuffer collisionSoundBuffer;
-    sf::Sound collisionSound;
+    float cloudTimer;
+    float cloudStep; // distance every cloud moved in the last update
+    float renderAlpha; // how far draw is between the last two ticks, 1 draws the latest tick as is
+    SpriteBatch worldBatch; // background, ground, clouds and bird
+    RenderStats renderStats;
+    Profiler profiler;
+    ProfilerOverlay profilerOverlay;
+    // Audio is only opened in windowed mode
+    std::unique_ptr<sf::Music> backgroundMusic;
+    SoundBufferHandle collisionSoundBuffer;
+    std::unique_ptr<sf::Sound> collisionSound;
+    std::deque<std::pair<std::uint64_t, sf::Event>> scriptedInput; // events fed to a headless game, keyed by tick
+    std::uint64_t tickCount;
+    std::unique_ptr<InputRecording> recording; // set while the player's input is being recorded
+    std::string tracePath;
 
 public:
-    Game();
+    explicit Game(const GameOptions& options = GameOptions());
     void run();
+    void runHeadless(std::uint64_t ticks);
+    void queueInput(std::uint64_t tick, const sf::Event& event);
+    void queueRecording(const InputRecording& recording);
+    void startRecording();
+    bool saveRecording(const std::string& path);
+    static GameOptions getReplayOptions(const InputRecording& recording);
+    std::uint64_t getTickCount() const;
+    const RenderStats& getRenderStats() const;
+    const StepStats& getStepStats() const;
+    std::uint64_t getStateChecksum() const;
 
 private:
+    bool pollEvent(sf::Event& event);
     void processEvents();
     void update(float deltaTime);
+    void updateWordCollisions(const sf::FloatRect& birdBounds);
     void render();
+    void draw(sf::RenderTarget& target);
     void restartGame();
     void handleClouds(float deltaTime);
+    bool isShowingStaticScreen() const;
+    static void waitUntil(const std::chrono::steady_clock::time_point& deadline);
     bool checkBirdWordCollision(const sf::FloatRect& birdBounds, const sf::FloatRect& wordBounds);
 };
 
 // Game class functions
 // Constructor setting window size and title, bird file and position, background file and scroll speed
-Game::Game()
-    : window(sf::VideoMode(1440, 1080), "By what mistake were pigeons made so happy") // setting window size and title
-    , bird("assets/bird.png", sf::Vector2f(200.0f, window.getSize().y / 2)) // setting bird file and position
-    , background("assets/background.png", 150.0f) // setting backgound file and scroll speed
-    , ground("assets/ground.png", 50.0f, window.getSize())  // placing ground file
-    , startScreen(window.getSize()) // use window size to place start screen
-    , floatingWords("assets/James Henry - Pigeons.txt", startScreen.font, 300.0f, 0.5f, window.getSize(), ground.getSize().y) // setting floating words file, font, speed, interval and window size
+// Without a window the game runs on a virtual 1440x1080 surface; headless games also create no OpenGL context or audio device
+Game::Game(const GameOptions& options)
+    : headless(options.mode == GameMode::Headless) // setting headless mode
+    , assets(headless, { "assets/background.png", "assets/ground.png", "assets/cloud.png", "assets/bird.png" }) // packing the world sprites into one atlas; headless games only read image sizes
+    , random(options.seed) // seeding the game's random numbers
+    , windowSize(1440, 1080) // setting window size
+    , window(options.mode == GameMode::Windowed ? new sf::RenderWindow(sf::VideoMode(windowSize.x, windowSize.y), "By what mistake were pigeons made so happy") : nullptr) // setting window size and title
+    , isOpen(true) // setting the game open
+    , bird(assets, "assets/bird.png", sf::Vector2f(200.0f, windowSize.y / 2)) // setting bird file and position
+    , background(assets, "assets/background.png", 150.0f) // setting backgound file and scroll speed
+    , ground(assets, "assets/ground.png", 50.0f, windowSize)  // placing ground file
     , firstSpacePress(true) // setting first space press to true
+    , tickRate(std::max<std::uint32_t>(options.tickRate, 1)) // setting the simulation rate
+    , tickStep(1.0f / tickRate) // setting the simulation step
+    , framePacing(options.framePacing) // setting how frames are paced
+    , frameLimit(std::max<std::uint32_t>(options.frameLimit, 1)) // setting the frame cap
+    , redrawNeeded(true) // drawing the first frame
+    , maxCatchUpSteps(std::max<std::uint32_t>(options.maxCatchUpSteps, 1)) // setting the catch-up budget
+    , catchUpPolicy(options.catchUpPolicy) // setting what happens to ticks over the budget
+    , startScreen(windowSize, assets) // use window size to place start screen
+    , floatingWords(options.poemPath, startScreen.font, 300.0f, 0.5f, windowSize, ground.getSize().y, random, headless) // setting floating words file, font, speed, interval and window size
     , gameStartTime(0.0f) // setting game start time to 0
-    , exitScreen(window.getSize()) // setting exit screen to window size
-    , scoreBoard(window.getSize()) // setting score board to window size
-    , score(startScreen.font, sf::Vector2f(10.0f, window.getSize().y - 40.0f)) // setting score font and position
-    , saveScoreScreen(window.getSize()) // setting save score screen to window size
+    , gameTime(0.0f) // setting game time to 0
+    , boundsContactTicks(0) // the bird has not touched the top or the ground yet
+    , exitScreen(windowSize, assets) // setting exit screen to window size
+    , score(startScreen.font, sf::Vector2f(10.0f, windowSize.y - 40.0f)) // setting score font and position
+    , scoreBoard(windowSize, assets) // setting score board to window size
+    , saveScoreScreen(windowSize, assets) // setting save score screen to window size
+    , cloudTexture(assets.getTexture("assets/cloud.png")) // loading the cloud texture once for every cloud
+    , cloudTimer(0.0f) // setting cloud timer to 0
+    , cloudStep(0.0f) // clouds have not moved yet
+    , renderAlpha(1.0f) // drawing the latest tick until run interpolates
+    , profilerOverlay(assets.getFont("assets/arial.ttf"), 1000.0f / (framePacing == FramePacing::Capped ? frameLimit : 60)) // marking the frame budget in the profiler graph
+    , tickCount(0) // setting tick count to 0
+    , tracePath(options.tracePath) // setting where F4 saves the trace
 {
+    clouds.reserve(2); // a cloud crosses the window in under the 10 seconds between spawns, so ticks never grow the vector
+
+    if (!window) {
+        return;
+    }
+    window->setVerticalSyncEnabled(framePacing == FramePacing::VSync);
+
 	// Load the background music
-    if (!backgroundMusic.openFromFile("assets/background_music.mp3")) {
+    backgroundMusic.reset(new sf::Music());
+    if (!backgroundMusic->openFromFile("assets/background_music.mp3")) {
 		std::cerr << "Error loading background music" << std::endl;
 	}
-	backgroundMusic.setLoop(true); // set the background music to loop
+	backgroundMusic->setLoop(true); // set the background music to loop
 
-    if (!collisionSoundBuffer.loadFromFile("assets/collision.mp3")) {
-		std::cerr << "Error loading hit sound" << std::endl;
-	}
-    collisionSound.setBuffer(collisionSoundBuffer); // set the collision sound buffer
+    collisionSoundBuffer = assets.getSoundBuffer("assets/collision.mp3");
+    collisionSound.reset(new sf::Sound(*collisionSoundBuffer)); // set the collision sound buffer
 }
 
 
 void Game::handleClouds(float deltaTime) {
 
-    static float cloudTimer = 0.0f;
     cloudTimer += deltaTime;
 
     const int cloudSpeed = 200.0f; // set cloud speed
+    cloudStep = cloudSpeed * deltaTime;
 
     if (cloudTimer >= 10.0f) {  // spawn a cloud every 10 seconds
         // Spawn a new cloud at random interval
         cloudTimer = 0.0f; // reset the cloud timer
-        if (!cloudTexture.loadFromFile("assets/cloud.png")) {
-            std::cout << "Error loading cloud texture" << std::endl;
-        }
 
-        sf::Sprite cloudSprite(cloudTexture);
-        cloudSprite.setPosition(window.getSize().x, std::rand() % static_cast<int>(window.getSize().y - cloudSprite.getGlobalBounds().height));
+        sf::Sprite cloudSprite;
+        cloudTexture->applyTo(cloudSprite);
+        cloudSprite.setPosition(windowSize.x, random.next(static_cast<int>(windowSize.y - cloudSprite.getGlobalBounds().height)));
         clouds.push_back(cloudSprite);
     }
 
@@ -939,30 +3346,226 @@ void Game::handleClouds(float deltaTime) {
 void Game::run() {
     sf::Clock clock; // creating clock object to measure time
     sf::Time accumulator = sf::Time::Zero; // setting time accumulator to zero
-    sf::Time deltaTime = sf::seconds(1.0f / frameRate); // setting time delta to 1/frameRate
+    sf::Time deltaTime = sf::seconds(tickStep); // setting time delta to 1/tickRate
     
-    backgroundMusic.setVolume(50.0f); // set the background music volume to 50% (half of the maximum volume
-    backgroundMusic.play(); // play the background music
+    if (!window) {
+        std::cerr << "Game::run needs a window, use runHeadless instead" << std::endl;
+        return;
+    }
+
+    backgroundMusic->setVolume(50.0f); // set the background music volume to 50% (half of the maximum volume
+    backgroundMusic->play(); // play the background music
 
-    while (window.isOpen()) {
-        processEvents(); // check for user input
+    const sf::Time idleWait = sf::milliseconds(10); // how often an idle static screen checks for input
+    const std::uint64_t maxBacklogSteps = 4 * maxCatchUpSteps; // ticks kept for later frames when dilating
+    std::uint64_t lateSteps = 0; // ticks carried over from earlier frames
+    const std::chrono::nanoseconds framePeriod(1000000000 / frameLimit);
+    std::chrono::steady_clock::time_point nextFrame = std::chrono::steady_clock::now();
+    bool wasIdle = false;
+
+    while (isOpen) {
+        {
+            PROFILE_SCOPE(profiler, ProfilePhase::ProcessEvents);
+            processEvents(); // check for user input
+        }
+        if (!isOpen) {
+            break; // no ticks after the window closed, so a recording ends on the tick its Closed event was handled
+        }
         accumulator += clock.restart(); // add time elapsed since last restart to accumulator
 
-        while (accumulator >= deltaTime) { // 
+        // Run at most maxCatchUpSteps ticks, so a stall (a window drag, a debugger pause) cannot make every
+        // following frame slower by trying to run all the ticks it missed at once
+        std::uint32_t steps = 0;
+        while (accumulator >= deltaTime && steps < maxCatchUpSteps) { // 
             update(deltaTime.asSeconds()); // update the game objects (bird and background)
             accumulator -= deltaTime; // subtract delta time from accumulator
+            steps++;
+        }
+        std::uint64_t stillLate = lateSteps > steps ? lateSteps - steps : 0; // late ticks from earlier frames not run yet
+        lateSteps = 0;
+        if (accumulator >= deltaTime) {
+            std::uint64_t behind = static_cast<std::uint64_t>(accumulator / deltaTime);
+            std::uint64_t kept = catchUpPolicy == CatchUpPolicy::Dilate ? std::min<std::uint64_t>(behind, maxBacklogSteps) : 0;
+            stepStats.clampedSteps += kept > stillLate ? kept - stillLate : 0; // count each late tick once
+            stepStats.droppedSteps += behind - kept;
+            accumulator -= deltaTime * static_cast<float>(behind - kept);
+            lateSteps = kept;
+        }
+
+        // Static screens only change on input, so they are drawn once and then the loop just sleeps,
+        // still running the ticks that came due so recordings stay in step
+        bool idle = isShowingStaticScreen();
+        if (idle && wasIdle && !redrawNeeded) {
+            sf::sleep(idleWait);
+            profiler.skipFrame(); // idle passes draw no frame, so they are left out of the frame times
+            continue;
+        }
+        wasIdle = idle;
+        redrawNeeded = false;
+
+        renderAlpha = std::min(1.0f, accumulator / deltaTime); // draw the leftover fraction of a tick between the last two ticks
+        {
+            PROFILE_SCOPE(profiler, ProfilePhase::Render);
+            render();
+        }
+        profiler.endFrame();
+
+        if (framePacing == FramePacing::Capped) {
+            nextFrame += framePeriod;
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (nextFrame < now) {
+                nextFrame = now; // fell behind, start pacing again from this frame
+            }
+            waitUntil(nextFrame);
+        }
+    }
+}
+
+// Check if the screen shown only changes on input: start, game over, save score and scoreboard
+bool Game::isShowingStaticScreen() const {
+    return startScreen.isVisible || exitScreen.isVisible || saveScoreScreen.isVisible || scoreBoard.isVisible;
+}
+
+// Wait until the deadline for an even frame time
+// Sleeping can overshoot by a millisecond or two, so it sleeps until shortly before the deadline and spins the rest
+void Game::waitUntil(const std::chrono::steady_clock::time_point& deadline) {
+    const std::chrono::microseconds spinMargin(2000);
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (deadline - now > spinMargin) {
+        std::chrono::microseconds sleepTime = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now - spinMargin);
+        sf::sleep(sf::microseconds(sleepTime.count()));
+    }
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+// Run the simulation without rendering as fast as the CPU allows
+// Every tick handles all scripted input due at that tick and then advances one fixed step
+// Input due after the last step is still handled, as a window closed on that tick handled it before closing
+void Game::runHeadless(std::uint64_t ticks) {
+    const float deltaTime = tickStep;
+    for (std::uint64_t i = 0; isOpen; i++) {
+        // processEvents stops after the first event it acts on, like a frame that ran no update would
+        while (isOpen && !scriptedInput.empty() && scriptedInput.front().first <= tickCount) {
+            processEvents();
+        }
+        if (!isOpen || i == ticks) {
+            break;
+        }
+        update(deltaTime);
+    }
+}
+
+// Queue an input event for a headless game, handled at the given tick
+// Events must be queued in tick order
+void Game::queueInput(std::uint64_t tick, const sf::Event& event) {
+    scriptedInput.push_back(std::make_pair(tick, event));
+}
+
+// Queue every event of a recording, the game must be created with the recording's seed
+void Game::queueRecording(const InputRecording& recording) {
+    for (const auto& entry : recording.getEvents()) {
+        queueInput(entry.first, entry.second);
+    }
+}
+
+// Start recording the player's input from the window
+void Game::startRecording() {
+    recording.reset(new InputRecording(random.getSeed(), tickRate, !headless)); // only headless games approximate word sizes
+}
+
+// Get the options a recording replays with: its seed and tick rate, and offscreen when the recorded game measured
+// words with the font, so the words spawn where they did
+GameOptions Game::getReplayOptions(const InputRecording& recording) {
+    GameOptions options;
+    options.mode = recording.isMeasuredWithFont() ? GameMode::Offscreen : GameMode::Headless;
+    options.seed = recording.getSeed();
+    options.tickRate = recording.getTickRate();
+    return options;
+}
+
+// Save the input recorded so far
+bool Game::saveRecording(const std::string& path) {
+    if (!recording) {
+        return false;
+    }
+    recording->setEndTick(tickCount);
+    return recording->saveToFile(path);
+}
+
+// Get the number of simulation ticks run so far
+std::uint64_t Game::getTickCount() const {
+    return tickCount;
+}
+
+// Get what the last draw submitted and culled
+const RenderStats& Game::getRenderStats() const {
+    return renderStats;
+}
+
+// Get the ticks run late or skipped because a frame was over its catch-up budget
+const StepStats& Game::getStepStats() const {
+    return stepStats;
+}
+
+// Hash the simulation state, so a replay can be checked against the recorded run
+std::uint64_t Game::getStateChecksum() const {
+    std::uint64_t hash = 14695981039346656037ull; // FNV-1a
+    auto mix = [&hash](float value) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 4; i++) {
+            hash = (hash ^ ((bits >> (8 * i)) & 0xFF)) * 1099511628211ull;
         }
+    };
+    mix(bird.getPosition().x);
+    mix(bird.getPosition().y);
+    mix(bird.getVelocity().y);
+    mix(static_cast<float>(score.getValue()));
+    mix(static_cast<float>(score.getLives()));
+    mix(static_cast<float>(floatingWords.getRemainingCount()));
+    for (size_t i = floatingWords.getActiveBegin(); i < floatingWords.getLoadedEnd(); i++) {
+        if (floatingWords.isRetired(i)) {
+            continue;
+        }
+        mix(floatingWords.getPosition(i).x);
+        mix(floatingWords.getPosition(i).y);
+    }
+    mix(static_cast<float>(clouds.size()));
+    return hash;
+}
 
-        render();
+// Get the next event from the window, or from the input script when there is no window
+// Events the game reacts to are recorded with the tick they arrive at
+bool Game::pollEvent(sf::Event& event) {
+    if (window) {
+        if (!window->pollEvent(event)) {
+            return false;
+        }
+        if (recording && InputRecording::isRecorded(event)) {
+            recording->record(tickCount, event);
+        }
+        redrawNeeded = true; // any window event may change what an idle screen shows
+        return true;
+    }
+    if (!scriptedInput.empty() && scriptedInput.front().first <= tickCount) {
+        event = scriptedInput.front().second;
+        scriptedInput.pop_front();
+        if (recording && InputRecording::isRecorded(event)) {
+            recording->record(tickCount, event);
+        }
+        return true;
     }
+    return false;
 }
 
 // Game restart function
 void Game::restartGame() {
     // Reset the bird position and velocity
-    bird.setPosition(sf::Vector2f(200.0f, window.getSize().y / 2)); // set bird position
+    bird.setPosition(sf::Vector2f(200.0f, windowSize.y / 2)); // set bird position
     bird.setVelocity(sf::Vector2f(0.0f, 0.0f)); // set bird velocity  
-    bird.update(firstSpacePress); // update bird position and enable gravity
+    bird.update(tickStep, firstSpacePress); // update bird position and enable gravity
     firstSpacePress = false; // set first space press to false
 
     // Reset the lives
@@ -974,12 +3577,12 @@ void Game::restartGame() {
     // Reset the multiplier
     score.reset();
 
-    // Load the scores
-    scoreBoard.loadScores();
-    scoreBoard.setScoreBoard(window.getSize());
+    // Show the scores submitted so far, the table is kept in memory
+    scoreBoard.setScoreBoard(windowSize);
 
     // restart game clock
-    gameClock.restart();
+    gameTime = 0.0f;
+    boundsContactTicks = 0;
     gameStartTime = 0.0f; // set game start time to 0
 
     // start the score
@@ -991,13 +3594,7 @@ void Game::restartGame() {
     scoreBoard.isVisible = false; // hide score board
 
     // Reset the floating words
-    floatingWords.reset(); // reset floating words
-    float startSpawnTime = 0.5f; // set start spawn time to 0.5 seconds
-    for (size_t i = 0; i < floatingWords.words.size(); i++) {
-        float yPosition = std::rand() % static_cast<int>(floatingWords.floorPosition - floatingWords.skyPosition - floatingWords.words[i].getGlobalBounds().height) + floatingWords.skyPosition;
-        floatingWords.words[i].setPosition(window.getSize().x, yPosition);
-        floatingWords.spawnTimes[i] = i * floatingWords.spawnInterval;
-    }
+    floatingWords.reset(); // reset floating words to the start of the poem, with new positions
 
     floatingWords.setStartTime(gameStartTime); // set floating words start time to 0
     floatingWords.isVisible = true; // show floating words
@@ -1007,11 +3604,30 @@ void Game::restartGame() {
 // Get user input events => close window or flap bird (space key)
 void Game::processEvents() {
     sf::Event event;
-    while (window.pollEvent(event)) {
+    while (pollEvent(event)) {
         if (event.type == sf::Event::Closed) {
-            window.close();
+            if (window) {
+                window->close();
+            }
+            isOpen = false;
+            return;
+        }
+
+        // 'F4' saves the recorded trace
+        if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F4) {
+            if (getTraceRecorder().writeJson(tracePath)) {
+                std::cout << "Wrote " << tracePath << std::endl;
+            }
+            return;
+        }
+
+#ifdef FLAPPY_PROFILER
+        // 'F3' shows or hides the profiler
+        if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F3) {
+            profilerOverlay.isVisible = !profilerOverlay.isVisible;
             return;
         }
+#endif
 
         // General Character input on save score screen
         if (saveScoreScreen.isVisible && event.type == sf::Event::TextEntered) {
@@ -1024,11 +3640,11 @@ void Game::processEvents() {
             // Start screen is visible only
             if (startScreen.isVisible) {
                 startScreen.isVisible = false; // hide start screen
-                bird.update(firstSpacePress); // update bird position and enable gravity
+                bird.update(tickStep, firstSpacePress); // update bird position and enable gravity
                 firstSpacePress = false; // set first space press to false
-                gameClock.restart(); // restart game clock
+                gameTime = 0.0f; // restart game clock
                 floatingWords.isVisible = true; // show floating words
-                gameStartTime = gameClock.getElapsedTime().asSeconds(); // set game start time to current time
+                gameStartTime = gameTime; // set game start time to current time
                 floatingWords.setStartTime(gameStartTime); // set floating words start time to current time
                 return;
             }
@@ -1048,7 +3664,7 @@ void Game::processEvents() {
                     saveScoreScreen.isVisible = true; // show save score screen
                     exitScreen.isVisible = false; // hide exit screen
                     scoreBoard.isVisible = true; // show score board
-                    saveScoreScreen.setScore(score.getValue()); // set the score on the save score screen
+                    saveScoreScreen.setScore(score.getValue(), scoreBoard.getRank(score.getValue()), scoreBoard.getScoreCount() + 1); // set the score and the rank it would take on the save score screen
                     score.isVisible = false; // hide score
 
                     // Consume the TextEntered event
@@ -1057,7 +3673,7 @@ void Game::processEvents() {
                     */
                     sf::Event textEnteredEvent;
                     // Loop that waits for the 'S' key to be released
-                    while (window.pollEvent(textEnteredEvent)) {
+                    while (pollEvent(textEnteredEvent)) {
                         //
                         if (textEnteredEvent.type == sf::Event::TextEntered && textEnteredEvent.text.unicode == 'S') {
                             break;
@@ -1077,7 +3693,6 @@ void Game::processEvents() {
             // Save player name and score when a 3 letter name is entered
             if (saveScoreScreen.isVisible && scoreBoard.isVisible && saveScoreScreen.getPlayerName().size() == 3) {
                 scoreBoard.addScore(saveScoreScreen.getPlayerName(), score.getValue());
-                scoreBoard.saveScores();
                 restartGame();
                 return;
             }
@@ -1092,38 +3707,116 @@ bool Game::checkBirdWordCollision(const sf::FloatRect& birdBounds, const sf::Flo
 
 // Update game objects (bird, background, check for collision)
 void Game::update(float deltaTime) {
-    bird.update(!firstSpacePress); // update bird position
-    background.update(deltaTime); // update background position
-    ground.update(deltaTime); // update ground position
-    floatingWords.update(deltaTime); // update floating words position
-    handleClouds(deltaTime); // update clouds position  
-    score.update(); // update the score text
+    TRACE_SCOPE("update");
+    tickCount++;
+    gameTime += deltaTime; // advance the game clock by the fixed step so headless runs match real time
+    {
+        PROFILE_SCOPE(profiler, ProfilePhase::Bird);
+        bird.update(deltaTime, !firstSpacePress); // update bird position
+    }
+    if (!isShowingStaticScreen()) { // the world stands still behind static screens, so they can idle
+        {
+            PROFILE_SCOPE(profiler, ProfilePhase::Background);
+            background.update(deltaTime); // update background position
+        }
+        {
+            PROFILE_SCOPE(profiler, ProfilePhase::Ground);
+            ground.update(deltaTime); // update ground position
+        }
+        {
+            PROFILE_SCOPE(profiler, ProfilePhase::Clouds);
+            handleClouds(deltaTime); // update clouds position
+        }
+    }
+    else {
+        // A zero step moves nothing and clears the last step, so redraws of a static screen do not shift the frozen world
+        background.update(0.0f);
+        ground.update(0.0f);
+        cloudStep = 0.0f;
+    }
+    {
+        PROFILE_SCOPE(profiler, ProfilePhase::FloatingWords);
+        floatingWords.update(deltaTime); // update floating words position
+    }
+    {
+        PROFILE_SCOPE(profiler, ProfilePhase::Score);
+        score.update(); // update the score text
+    }
     // Check for collision between bird, window bounds and floating words
     sf::FloatRect birdBounds = bird.getBrounds();
+    {
+        PROFILE_SCOPE(profiler, ProfilePhase::Collision);
+        TRACE_SCOPE("collision");
+        updateWordCollisions(birdBounds);
+    }
+
+    // Check if thereare no more words left in the float words
+    if (floatingWords.isFinished() && !exitScreen.isVisible) {
+        floatingWords.isVisible = false; // hide floating words
+        exitScreen.isVisible = true; // show exit screen
+        exitScreen.setScore(score.getValue()); // set the score on the exit screen
+        score.isVisible = false; // hide score  
+        bird.setPosition(sf::Vector2f(-400.0f, -400.0f)); // set bird position off the screen
+    }
+
+    if (!exitScreen.isVisible && !startScreen.isVisible && !saveScoreScreen.isVisible && !scoreBoard.isVisible) { // check for collision between bird and window bounds only if not in exit screen and start screen and save score screen and score board is visible
+
+        bool touchedBounds = false;
+        if (birdBounds.top < 0.0f) {
+            bird.setPosition(sf::Vector2f(birdBounds.left, 0.0f));
+            bird.setVelocity(sf::Vector2f(bird.getVelocity().x, -bird.getVelocity().y * 0.3f));
+            touchedBounds = true; // the bird hit the top of the window
+        }
+        else if (birdBounds.top + birdBounds.height > windowSize.y - ground.getSize().y) { // check for collision between bird and ground
+            bird.setPosition(sf::Vector2f(birdBounds.left, windowSize.y - ground.getSize().y - birdBounds.height)); // set bird position to the top of the ground
+            bird.setVelocity(sf::Vector2f(bird.getVelocity().x, -bird.getVelocity().y * 0.5f)); // set bird velocity
+            touchedBounds = true; // the bird hit the ground
+        }
+
+        // A bird resting on the ground touches it every tick, so the penalty is a point per 1/60 s of contact
+        // rather than per tick, which keeps the score the same at every tick rate
+        if (touchedBounds) {
+            boundsContactTicks++;
+            std::uint64_t owed = boundsContactTicks * 60 / tickRate - (boundsContactTicks - 1) * 60 / tickRate;
+            score.decrement(static_cast<int>(owed));
+        }
+    }
+
+    
+
+}
 
-   
-    // Check for collision between bird and window bounds
-    for (size_t i = 0; i < floatingWords.words.size(); i++) {
-        if ((floatingWords.spawnTimes[i] <= gameClock.getElapsedTime().asSeconds() - gameStartTime) && floatingWords.isVisible) {
+// Collect the floating words the bird touches and count the words it misses
+// Active words are sorted from left to right and words the bird has passed are retired, so the sweep
+// starts at the few words left of the bird and stops at the first word right of it
+// Words still waiting to spawn sit right of the window and are never tested
+void Game::updateWordCollisions(const sf::FloatRect& birdBounds) {
+    float birdRight = birdBounds.left + birdBounds.width;
+    for (size_t i = floatingWords.getActiveBegin(); i < floatingWords.getActiveEnd(); i++) {
+        if (floatingWords.isRetired(i)) {
+            continue; // collected earlier
+        }
+        if (floatingWords.startsRightOf(i, birdRight)) {
+            break; // this word and every word after it are right of the bird
+        }
+        if (floatingWords.isVisible) {
             sf::FloatRect wordBounds = floatingWords.getBounds(i);
             if (checkBirdWordCollision(birdBounds, wordBounds)) { // check for collision between bird and word
-                collisionSound.play(); // play the start sound
+                if (collisionSound) {
+                    collisionSound->play(); // play the start sound
+                }
                 score.increment(10); // Increase the score by 10 points
                 score.incrementMultiplier(); // Increase the multiplier
-                floatingWords.words.erase(floatingWords.words.begin() + i); // erase the word
-                floatingWords.spawnTimes.erase(floatingWords.spawnTimes.begin() + i); // erase the spawn time
-                i--; // decrement i
+                floatingWords.retireWord(i); // retire the collected word
                 score.resetLives();
             }
             else if (wordBounds.left + wordBounds.width < birdBounds.left - 50.0f) { // check if the word has passed the bird by 10 pixels
-                floatingWords.words[i].setFillColor(sf::Color::Red); // set the color of the word to red
+                floatingWords.markMissed(i); // set the color of the word to red
                 if (wordBounds.left + wordBounds.width < birdBounds.left - 100.0f) {
 
-                    floatingWords.words.erase(floatingWords.words.begin() + i); // erase the word
-                    floatingWords.spawnTimes.erase(floatingWords.spawnTimes.begin() + i); // erase the spawn time
+                    floatingWords.retireWord(i); // retire the missed word
                     score.resetMultiplier(); // reset the multiplier
                     score.decrementLives(); // decrement the lives
-                    i--; // decrement i
                 }
 
                 if (score.getLives() == 0) {
@@ -1138,72 +3831,634 @@ void Game::update(float deltaTime) {
             }
         }
     }
-
-    // Check if thereare no more words left in the float words
-    if (floatingWords.words.empty() && !exitScreen.isVisible) {
-        floatingWords.isVisible = false; // hide floating words
-        exitScreen.isVisible = true; // show exit screen
-        exitScreen.setScore(score.getValue()); // set the score on the exit screen
-        score.isVisible = false; // hide score  
-        bird.setPosition(sf::Vector2f(-400.0f, -400.0f)); // set bird position off the screen
-    }
-
-    if (!exitScreen.isVisible && !startScreen.isVisible && !saveScoreScreen.isVisible && !scoreBoard.isVisible) { // check for collision between bird and window bounds only if not in exit screen and start screen and save score screen and score board is visible
-
-        if (birdBounds.top < 0.0f) {
-            bird.setPosition(sf::Vector2f(birdBounds.left, 0.0f));
-            bird.setVelocity(sf::Vector2f(bird.getVelocity().x, -bird.getVelocity().y * 0.3f));
-            score.decrement(1); // Decrease the score by 10 points if the bird hits the top of the window
-        }
-        else if (birdBounds.top + birdBounds.height > window.getSize().y - ground.getSize().y) { // check for collision between bird and ground
-            bird.setPosition(sf::Vector2f(birdBounds.left, window.getSize().y - ground.getSize().y - birdBounds.height)); // set bird position to the top of the ground
-            bird.setVelocity(sf::Vector2f(bird.getVelocity().x, -bird.getVelocity().y * 0.5f)); // set bird velocity
-            score.decrement(1); // Decrease the score by 10 points if the bird hits the ground
-        }
-    }
-
-    
-
 }
 
 // Render game objects (bird and background)
 void Game::render() {
-    window.clear();
-    background.draw(window);
-    ground.draw(window);
+    if (!window) {
+        return; // nothing to draw on without a window
+    }
+    TRACE_SCOPE("render");
+    window->clear();
+    draw(*window);
+    window->display();
+}
+
+// Draw game objects on a window or an offscreen texture
+// The world sprites all come from one atlas, so they go out in a single batched draw call
+// Moving objects are drawn renderAlpha of the way from their previous tick to their latest one
+// Clouds outside the view, like the ones just spawned right of the window, are culled
+void Game::draw(sf::RenderTarget& target) {
+    sf::FloatRect visibleArea = getVisibleArea(target);
+    renderStats = RenderStats();
+    worldBatch.begin(target);
+    background.draw(worldBatch, renderAlpha);
+    ground.draw(worldBatch, renderAlpha);
+    sf::Vector2f cloudLag((1.0f - renderAlpha) * cloudStep, 0.0f); // every cloud moved by the same step
     for (const auto& cloud : clouds) {
-        window.draw(cloud);
+        sf::FloatRect cloudBounds = cloud.getGlobalBounds();
+        cloudBounds.left += cloudLag.x;
+        if (cloudBounds.intersects(visibleArea)) {
+            worldBatch.add(cloud, cloudLag);
+            renderStats.cloudsDrawn++;
+        }
+        else {
+            renderStats.cloudsCulled++;
+        }
     }
     if (bird.getPosition().x >= 0 && bird.getPosition().y >= 0) {
-        bird.draw(window);
+        bird.draw(worldBatch, renderAlpha);
     }
+    worldBatch.end();
     if (startScreen.isVisible) {
-        startScreen.draw(window);
+        startScreen.draw(target);
     }
     if (exitScreen.isVisible && !saveScoreScreen.isVisible && !scoreBoard.isVisible) {
-        exitScreen.draw(window);
+        exitScreen.draw(target);
     }
     if (saveScoreScreen.isVisible) {
-        saveScoreScreen.draw(window);
+        saveScoreScreen.draw(target);
     }
     if (floatingWords.isVisible) {
-        floatingWords.draw(window);
+        floatingWords.draw(target, renderAlpha);
+        renderStats.wordsDrawn = floatingWords.getDrawnCount();
+        renderStats.wordsCulled = floatingWords.getCulledCount();
     }
     if (!startScreen.isVisible && !exitScreen.isVisible) {
-        score.draw(window);
+        score.draw(target);
+    }
+    scoreBoard.draw(target);
+    profilerOverlay.draw(target, profiler);
+}
+
+
+// BENCHMARK CLASS
+
+// Times the simulation and rendering over generated poems of 100, 10k and 1M words
+// Each case reports the mean, p50, p99 and p999 tick time and the heap allocations per tick
+class GameBenchmark {
+private:
+    std::uint64_t ticks;
+    bool includeRender;
+    std::uint64_t steadyTickAllocations; // heap allocations in update ticks that left the HUD as it was
+
+    static std::string writePoem(size_t wordCount);
+    static void startPlaying(Game& game);
+    static void keepPlaying(Game& game, std::uint64_t tick);
+    static void report(const std::string& name, size_t wordCount, std::vector<std::int64_t>& samples, std::uint64_t allocations);
+    static std::int64_t nanosecondsSince(const std::chrono::steady_clock::time_point& start);
+    std::unique_ptr<Game> startGame(const std::string& poemPath, size_t wordCount, GameMode mode, std::vector<std::int64_t>& samples, bool reportLoad = false);
+    void benchUpdate(const std::string& poemPath, size_t wordCount);
+    void benchCollision(const std::string& poemPath, size_t wordCount);
+    void benchFloatingWords(const std::string& poemPath, size_t wordCount);
+    void benchRender(const std::string& poemPath, size_t wordCount);
+    void benchKernels(size_t wordCount);
+
+public:
+    GameBenchmark(std::uint64_t ticks, bool includeRender);
+    bool run();
+};
+
+GameBenchmark::GameBenchmark(std::uint64_t ticks, bool includeRender)
+    : ticks(ticks), includeRender(includeRender), steadyTickAllocations(0) {
+}
+
+// Write a poem of the given length by repeating the words of the game's poem
+std::string GameBenchmark::writePoem(size_t wordCount) {
+    std::vector<std::string> sourceWords;
+    std::ifstream source(GameOptions().poemPath);
+    std::string word;
+    while (source >> word) {
+        sourceWords.push_back(word);
+    }
+    if (sourceWords.empty()) {
+        sourceWords.push_back("pigeons");
+    }
+
+    std::string path = "benchmark_" + std::to_string(wordCount) + "_words.txt";
+    std::ofstream file(path);
+    for (size_t i = 0; i < wordCount; i++) {
+        file << sourceWords[i % sourceWords.size()] << (i % 12 == 11 ? '\n' : ' ');
+    }
+    file.close();
+    WordIndex::build(path, sf::Font(), false); // index the poem up front, so load times the mapped index
+    return path;
+}
+
+// Press Space to leave the start screen
+void GameBenchmark::startPlaying(Game& game) {
+    sf::Event spacePress;
+    spacePress.type = sf::Event::KeyPressed;
+    spacePress.key.code = sf::Keyboard::Space;
+    game.queueInput(game.tickCount, spacePress);
+    game.processEvents();
+}
+
+// Flap at a fixed interval and refill the lives, so the run never reaches the exit screen
+// The refill is shown before the tick, so a timed tick only changes the HUD when it changes the score or lives
+void GameBenchmark::keepPlaying(Game& game, std::uint64_t tick) {
+    if (tick % 20 == 0) {
+        game.bird.flap();
+    }
+    game.score.resetLives();
+    game.score.update();
+}
+
+std::int64_t GameBenchmark::nanosecondsSince(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Print one line of results
+void GameBenchmark::report(const std::string& name, size_t wordCount, std::vector<std::int64_t>& samples, std::uint64_t allocations) {
+    if (samples.empty()) {
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double fraction) {
+        return samples[std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()))];
+    };
+    double total = 0.0;
+    for (std::int64_t sample : samples) {
+        total += static_cast<double>(sample);
+    }
+
+    std::cout << std::left << std::setw(16) << name << std::right
+        << std::setw(9) << wordCount
+        << std::setw(14) << std::fixed << std::setprecision(1) << total / samples.size()
+        << std::setw(12) << percentile(0.5)
+        << std::setw(12) << percentile(0.99)
+        << std::setw(12) << percentile(0.999)
+        << std::setw(14) << std::setprecision(2) << static_cast<double>(allocations) / samples.size()
+        << std::defaultfloat << std::endl;
+}
+
+// Create a game on the poem and start playing, with room in samples for every timed tick
+// The load case also times creating the game, which maps the poem's index
+std::unique_ptr<Game> GameBenchmark::startGame(const std::string& poemPath, size_t wordCount, GameMode mode, std::vector<std::int64_t>& samples, bool reportLoad) {
+    GameOptions options;
+    options.mode = mode;
+    options.poemPath = poemPath;
+
+    auto loadStart = std::chrono::steady_clock::now();
+    std::uint64_t loadAllocations = getHeapAllocationCount();
+    std::unique_ptr<Game> game(new Game(options));
+    if (reportLoad) {
+        std::vector<std::int64_t> loadSample(1, nanosecondsSince(loadStart));
+        report("load", wordCount, loadSample, getHeapAllocationCount() - loadAllocations);
+    }
+
+    startPlaying(*game);
+    samples.clear();
+    samples.reserve(ticks);
+    return game;
+}
+
+// Whole simulation ticks through Game::update
+void GameBenchmark::benchUpdate(const std::string& poemPath, size_t wordCount) {
+    std::vector<std::int64_t> samples;
+    std::unique_ptr<Game> game = startGame(poemPath, wordCount, GameMode::Headless, samples, true);
+    const float deltaTime = game->tickStep;
+    std::uint64_t allocations = 0;
+    for (std::uint64_t tick = 0; tick < ticks; tick++) {
+        keepPlaying(*game, tick);
+        int scoreBefore = game->score.getValue();
+        int livesBefore = game->score.getLives();
+        std::uint64_t allocationsBefore = getHeapAllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        game->update(deltaTime);
+        samples.push_back(nanosecondsSince(start));
+        std::uint64_t tickAllocations = getHeapAllocationCount() - allocationsBefore;
+        allocations += tickAllocations;
+        if (game->score.getValue() == scoreBefore && game->score.getLives() == livesBefore) {
+            steadyTickAllocations += tickAllocations;
+        }
+    }
+    report("update", wordCount, samples, allocations);
+}
+
+// Only the bird-vs-word collision loop, with the words moved between the timed calls
+void GameBenchmark::benchCollision(const std::string& poemPath, size_t wordCount) {
+    std::vector<std::int64_t> samples;
+    std::unique_ptr<Game> game = startGame(poemPath, wordCount, GameMode::Headless, samples);
+    const float deltaTime = game->tickStep;
+    std::uint64_t allocations = 0;
+    for (std::uint64_t tick = 0; tick < ticks; tick++) {
+        keepPlaying(*game, tick);
+        game->gameTime += deltaTime;
+        game->floatingWords.update(deltaTime);
+        sf::FloatRect birdBounds = game->bird.getBrounds();
+        std::uint64_t allocationsBefore = getHeapAllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        game->updateWordCollisions(birdBounds);
+        samples.push_back(nanosecondsSince(start));
+        allocations += getHeapAllocationCount() - allocationsBefore;
+    }
+    report("collision", wordCount, samples, allocations);
+}
+
+// Only FloatingWords::update, no words are collected or missed
+void GameBenchmark::benchFloatingWords(const std::string& poemPath, size_t wordCount) {
+    std::vector<std::int64_t> samples;
+    std::unique_ptr<Game> game = startGame(poemPath, wordCount, GameMode::Headless, samples);
+    const float deltaTime = game->tickStep;
+    std::uint64_t allocations = 0;
+    for (std::uint64_t tick = 0; tick < ticks; tick++) {
+        std::uint64_t allocationsBefore = getHeapAllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        game->floatingWords.update(deltaTime);
+        samples.push_back(nanosecondsSince(start));
+        allocations += getHeapAllocationCount() - allocationsBefore;
+    }
+    report("words.update", wordCount, samples, allocations);
+}
+
+// Game::draw into an offscreen texture, timing the CPU side of the frame
+void GameBenchmark::benchRender(const std::string& poemPath, size_t wordCount) {
+    std::vector<std::int64_t> samples;
+    std::unique_ptr<Game> game = startGame(poemPath, wordCount, GameMode::Offscreen, samples);
+    const float deltaTime = game->tickStep;
+    sf::RenderTexture target;
+    if (!target.create(game->windowSize.x, game->windowSize.y)) {
+        std::cerr << "Error creating offscreen render texture" << std::endl;
+        return;
+    }
+
+    std::uint64_t allocations = 0;
+    RenderStats totals;
+    for (std::uint64_t tick = 0; tick < ticks; tick++) {
+        keepPlaying(*game, tick);
+        game->update(deltaTime);
+        std::uint64_t allocationsBefore = getHeapAllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        target.clear();
+        game->draw(target);
+        target.display();
+        samples.push_back(nanosecondsSince(start));
+        allocations += getHeapAllocationCount() - allocationsBefore;
+        const RenderStats& stats = game->getRenderStats();
+        totals.wordsDrawn += stats.wordsDrawn;
+        totals.wordsCulled += stats.wordsCulled;
+        totals.cloudsDrawn += stats.cloudsDrawn;
+        totals.cloudsCulled += stats.cloudsCulled;
+    }
+    report("render", wordCount, samples, allocations);
+
+    // Average objects submitted and culled per frame
+    double frames = static_cast<double>(std::max<std::uint64_t>(ticks, 1));
+    std::cout << std::left << std::setw(16) << "render.culling" << std::right
+        << std::setw(9) << wordCount
+        << std::fixed << std::setprecision(1)
+        << "   words drawn " << totals.wordsDrawn / frames << " culled " << totals.wordsCulled / frames
+        << ", clouds drawn " << totals.cloudsDrawn / frames << " culled " << totals.cloudsCulled / frames
+        << std::defaultfloat << std::endl;
+}
+
+// The word advance kernel alone, scalar against SIMD, over the x positions of every word of the poem at once
+// The game only moves the active words, so this is the kernel's throughput and not a per-tick cost; words.update is that
+void GameBenchmark::benchKernels(size_t wordCount) {
+    std::vector<float> positionsX(wordCount);
+    for (size_t i = 0; i < wordCount; i++) {
+        positionsX[i] = i * 150.0f; // words spawn half a second apart at 300 pixels per second
+    }
+
+    const float step = 300.0f / 60.0f; // one 60 Hz tick of word movement
+    std::vector<std::int64_t> samples;
+    samples.reserve(ticks);
+    for (std::uint64_t tick = 0; tick < ticks; tick++) {
+        auto start = std::chrono::steady_clock::now();
+        subtractScalarReference(positionsX.data(), positionsX.size(), step);
+        samples.push_back(nanosecondsSince(start));
+    }
+    report("kernel.scalar", wordCount, samples, 0);
+
+    samples.clear();
+    for (std::uint64_t tick = 0; tick < ticks; tick++) {
+        auto start = std::chrono::steady_clock::now();
+        subtractSimd(positionsX.data(), positionsX.size(), step);
+        samples.push_back(nanosecondsSince(start));
+    }
+    report(std::string("kernel.") + getSimdName(), wordCount, samples, 0);
+}
+
+// Run every case for every poem length
+// Fails when an update tick that left the HUD as it was allocated on the heap
+bool GameBenchmark::run() {
+    const size_t wordCounts[] = { 100, 10000, 1000000 };
+
+    std::cout << std::left << std::setw(16) << "case" << std::right
+        << std::setw(9) << "words"
+        << std::setw(14) << "ns/tick"
+        << std::setw(12) << "p50 ns"
+        << std::setw(12) << "p99 ns"
+        << std::setw(12) << "p999 ns"
+        << std::setw(14) << "allocs/tick" << std::endl;
+
+    for (size_t wordCount : wordCounts) {
+        std::string poemPath = writePoem(wordCount);
+        benchUpdate(poemPath, wordCount);
+        benchCollision(poemPath, wordCount);
+        benchFloatingWords(poemPath, wordCount);
+        benchKernels(wordCount);
+        if (includeRender) {
+            benchRender(poemPath, wordCount);
+        }
+        std::remove(poemPath.c_str());
+        std::remove(WordIndex::getIndexPath(poemPath).c_str());
+    }
+
+    if (steadyTickAllocations > 0) {
+        std::cerr << "Steady-state update ticks made " << steadyTickAllocations << " heap allocations, expected none" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+
+// SELF TEST CLASS
+
+// Checks that need no window, run with --self-test
+// Each check prints one line; the run fails if any check fails
+class GameSelfTest {
+private:
+    static bool checkReplay(GameMode mode, const std::string& name, std::uint64_t closeTick = 0);
+    static bool hasDisplay();
+
+public:
+    static bool run();
+};
+
+// Record a scripted game, save and load the recording, replay it and compare the final state
+// An offscreen game measures words with the font like a windowed one, so it stands in for a recording made in a window
+// A non-zero closeTick closes the game at that tick, which must end the recording there
+bool GameSelfTest::checkReplay(GameMode mode, const std::string& name, std::uint64_t closeTick) {
+    const std::string path = "selftest_" + name + ".fbir";
+    GameOptions options;
+    options.mode = mode;
+    options.seed = 12345;
+    Game recorded(options);
+
+    sf::Event spacePress;
+    spacePress.type = sf::Event::KeyPressed;
+    spacePress.key.code = sf::Keyboard::Space;
+    sf::Event enterPress;
+    enterPress.type = sf::Event::KeyPressed;
+    enterPress.key.code = sf::Keyboard::Enter;
+    sf::Event closed;
+    closed.type = sf::Event::Closed;
+    const std::uint64_t ticks = 3000;
+    for (std::uint64_t tick = 0; tick < ticks; tick++) {
+        if (tick % 13 == 0) {
+            recorded.queueInput(tick, spacePress);
+        }
+        if (tick % 600 == 300) {
+            recorded.queueInput(tick, enterPress); // restarts the game if it ended
+        }
+        if (tick == closeTick && closeTick > 0) {
+            recorded.queueInput(tick, closed);
+        }
     }
-    scoreBoard.draw(window);
-    window.display();
+    recorded.startRecording();
+    recorded.runHeadless(ticks);
+    bool saved = recorded.saveRecording(path);
+
+    InputRecording recording;
+    bool loaded = saved && recording.loadFromFile(path);
+    std::remove(path.c_str());
+    bool passed = false;
+    if (loaded && (closeTick == 0 || recorded.getTickCount() == closeTick)) {
+        Game replayed(Game::getReplayOptions(recording));
+        replayed.queueRecording(recording);
+        replayed.runHeadless(recording.getEndTick());
+        passed = replayed.getTickCount() == recorded.getTickCount() && replayed.getStateChecksum() == recorded.getStateChecksum();
+    }
+    std::cout << std::left << std::setw(24) << ("replay." + name) << (passed ? "ok" : "FAILED") << std::endl;
+    return passed;
+}
+
+// Check if an OpenGL context can be created; without an X display SFML aborts instead of failing
+bool GameSelfTest::hasDisplay() {
+#if defined(_WIN32) || defined(__APPLE__)
+    return true;
+#else
+    const char* display = std::getenv("DISPLAY");
+    return display && display[0] != '\0';
+#endif
+}
 
+// Run every check; the offscreen one is skipped on machines without a display, so CI can run the rest
+bool GameSelfTest::run() {
+    bool passed = checkReplay(GameMode::Headless, "headless");
+    passed = checkReplay(GameMode::Headless, "closed", 1500) && passed;
+    if (hasDisplay()) {
+        passed = checkReplay(GameMode::Offscreen, "font-measured") && passed;
+    }
+    else {
+        std::cout << std::left << std::setw(24) << "replay.font-measured" << "skipped, no display" << std::endl;
+    }
+    return passed;
 }
 
 
+
 // MAIN FUNCTION
 
 // Main function to run the game
-int main() {
-    std::srand(static_cast<unsigned int>(std::time(nullptr))); // setting random seed based on current time
-    Game game; // creating game object
+// --headless <ticks> runs the simulation without a window and prints the tick rate
+// --flap-every <ticks> flaps the bird at a fixed interval during a headless run
+// --seed <n> seeds the game's random numbers
+// --tick-rate <hz> sets the fixed simulation rate, 60 by default; 120 or 240 lower input latency
+// --frame-pacing <uncapped|vsync|fps> sets how frames are paced, capped at 60 frames per second by default
+// --max-catch-up <ticks> limits the ticks run in one frame, 5 by default
+// --catch-up <dilate|drop> runs ticks over that limit in later frames or skips them
+// --record <file> saves the player's input when the window is closed
+// --replay <file> replays a recording without a window and prints the final state
+// --bench <ticks> times the simulation over 100, 10k and 1M word poems
+// --bench-render <ticks> also times drawing into an offscreen texture, which needs OpenGL
+// --build-index <poem> writes the word index of a poem, measured with the game's font
+// --self-test 1 runs the checks that need no window and exits with 1 if one fails
+// --trace <file> saves the recorded trace when the game ends; F4 saves it while playing
+int main(int argc, char* argv[]) {
+    std::uint32_t seed = static_cast<std::uint32_t>(std::time(nullptr)); // setting random seed based on current time
+
+    std::uint64_t headlessTicks = 0;
+    std::uint64_t flapInterval = 20;
+    std::uint32_t tickRate = 60;
+    FramePacing framePacing = FramePacing::Capped;
+    std::uint32_t frameLimit = 60;
+    std::uint32_t maxCatchUpSteps = 5;
+    CatchUpPolicy catchUpPolicy = CatchUpPolicy::Dilate;
+    std::string recordPath;
+    std::string replayPath;
+    std::uint64_t benchTicks = 0;
+    bool benchRender = false;
+    std::string indexPoemPath;
+    std::string tracePath;
+    bool selfTest = false;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--headless") {
+            headlessTicks = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+        else if (option == "--flap-every") {
+            flapInterval = std::max<std::uint64_t>(1, std::strtoull(argv[i + 1], nullptr, 10));
+        }
+        else if (option == "--seed") {
+            seed = static_cast<std::uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        }
+        else if (option == "--frame-pacing") {
+            std::string pacing = argv[i + 1];
+            if (pacing == "uncapped") {
+                framePacing = FramePacing::Uncapped;
+            }
+            else if (pacing == "vsync") {
+                framePacing = FramePacing::VSync;
+            }
+            else {
+                framePacing = FramePacing::Capped;
+                frameLimit = static_cast<std::uint32_t>(std::strtoul(pacing.c_str(), nullptr, 10));
+                if (frameLimit == 0) {
+                    std::cerr << "--frame-pacing needs uncapped, vsync or a frame rate" << std::endl;
+                    return 1;
+                }
+            }
+        }
+        else if (option == "--max-catch-up") {
+            maxCatchUpSteps = static_cast<std::uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+            if (maxCatchUpSteps == 0) {
+                std::cerr << "--max-catch-up needs a positive number of ticks" << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--catch-up") {
+            catchUpPolicy = std::string(argv[i + 1]) == "drop" ? CatchUpPolicy::Drop : CatchUpPolicy::Dilate;
+        }
+        else if (option == "--tick-rate") {
+            tickRate = static_cast<std::uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+            if (tickRate == 0) {
+                std::cerr << "--tick-rate needs a positive number of ticks per second" << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--record") {
+            recordPath = argv[i + 1];
+        }
+        else if (option == "--replay") {
+            replayPath = argv[i + 1];
+        }
+        else if (option == "--bench" || option == "--bench-render") {
+            benchTicks = std::strtoull(argv[i + 1], nullptr, 10);
+            benchRender = option == "--bench-render";
+        }
+        else if (option == "--build-index") {
+            indexPoemPath = argv[i + 1];
+        }
+        else if (option == "--trace") {
+            tracePath = argv[i + 1];
+        }
+        else if (option == "--self-test") {
+            selfTest = std::string(argv[i + 1]) != "0";
+        }
+    }
+
+    if (!indexPoemPath.empty()) {
+        sf::Font font;
+        if (!font.loadFromFile("assets/arial.ttf")) {
+            std::cerr << "Error loading font" << std::endl;
+            return 1;
+        }
+        if (!WordIndex::build(indexPoemPath, font, true)) {
+            return 1;
+        }
+        std::cout << "Wrote " << WordIndex::getIndexPath(indexPoemPath) << std::endl;
+        return 0;
+    }
+
+    if (selfTest) {
+        return GameSelfTest::run() ? 0 : 1;
+    }
+
+    if (benchTicks > 0) {
+        GameBenchmark benchmark(benchTicks, benchRender);
+        return benchmark.run() ? 0 : 1;
+    }
+
+    if (!replayPath.empty()) {
+        InputRecording recording;
+        if (!recording.loadFromFile(replayPath)) {
+            std::cerr << "Error loading input recording " << replayPath << std::endl;
+            return 1;
+        }
+        Game game(Game::getReplayOptions(recording)); // creating a windowless game with the recorded seed, tick rate and word measurement
+        game.queueRecording(recording);
+
+        sf::Clock clock;
+        game.runHeadless(recording.getEndTick());
+        float seconds = clock.getElapsedTime().asSeconds();
+        std::cout << "Replayed " << game.getTickCount() << " ticks in " << seconds * 1000.0f << " ms, state checksum "
+            << std::hex << game.getStateChecksum() << std::dec << std::endl;
+        if (!tracePath.empty()) {
+            getTraceRecorder().writeJson(tracePath);
+        }
+        return 0;
+    }
+
+    if (headlessTicks > 0) {
+        GameOptions options;
+        options.mode = GameMode::Headless;
+        options.seed = seed;
+        options.tickRate = tickRate;
+        Game game(options); // creating headless game object
+
+        // Script the input: start the game on the first tick, then flap at a fixed interval
+        sf::Event spacePress;
+        spacePress.type = sf::Event::KeyPressed;
+        spacePress.key.code = sf::Keyboard::Space;
+        for (std::uint64_t tick = 0; tick < headlessTicks; tick += flapInterval) {
+            game.queueInput(tick, spacePress);
+        }
+
+        sf::Clock clock;
+        game.runHeadless(headlessTicks); // running game without a window
+        float seconds = clock.getElapsedTime().asSeconds();
+        std::cout << "Simulated " << game.getTickCount() << " ticks in " << seconds * 1000.0f << " ms ("
+            << (seconds > 0.0f ? game.getTickCount() / seconds : 0.0f) << " ticks/s), state checksum "
+            << std::hex << game.getStateChecksum() << std::dec << std::endl;
+        if (!tracePath.empty()) {
+            getTraceRecorder().writeJson(tracePath);
+        }
+        return 0;
+    }
+
+    GameOptions options;
+    options.seed = seed;
+    options.tickRate = tickRate;
+    options.framePacing = framePacing;
+    options.frameLimit = frameLimit;
+    options.maxCatchUpSteps = maxCatchUpSteps;
+    options.catchUpPolicy = catchUpPolicy;
+    if (!tracePath.empty()) {
+        options.tracePath = tracePath;
+    }
+    Game game(options); // creating game object
+    if (!recordPath.empty()) {
+        game.startRecording();
+    }
     game.run(); // running game
+    const StepStats& stepStats = game.getStepStats();
+    if (stepStats.clampedSteps > 0 || stepStats.droppedSteps > 0) {
+        std::cout << "Frames over the catch-up budget: " << stepStats.clampedSteps << " ticks run late, "
+            << stepStats.droppedSteps << " ticks dropped" << std::endl;
+    }
+    if (!recordPath.empty()) {
+        if (!game.saveRecording(recordPath)) {
+            std::cerr << "Error saving input recording " << recordPath << std::endl;
+        }
+        std::cout << "Recorded " << game.getTickCount() << " ticks, state checksum "
+            << std::hex << game.getStateChecksum() << std::dec << std::endl;
+    }
+    if (!tracePath.empty()) {
+        getTraceRecorder().writeJson(tracePath);
+    }
     return 0;
 }
\ No newline at end of file